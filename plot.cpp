@@ -15,15 +15,84 @@
 #include <assert.h>
 #include <condition_variable>
 #include <mutex>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <barrier>
+#include <bit>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <string_view>
+#include <limits>
+#include <type_traits>
 
 constexpr uint64_t max_iter_initial = 100;
 constexpr uint64_t float_precision = 128;
 constexpr uint64_t window_width = 1000;
 constexpr uint64_t window_height = 800;
 constexpr uint64_t max_threads = 64;
+// render work unit, workers pull tiles until none are left
+constexpr int render_tile_size = 64;
+// entries of the float color lut, independent of max_iter
+constexpr uint64_t palette_size = 1024;
+// COLOR_MODULO: iterations per palette turn, COLOR_LOG: doublings of the iteration count per turn
+constexpr float color_period = 100;
+constexpr float log_color_period = 4;
+// COLOR_HISTOGRAM: log spaced bins over 1..max_iter
+constexpr uint64_t histogram_bins = 4096;
+// antialiasing: pixels whose color differs from a neighbour by more than aa_threshold in one
+// channel get aa_grid x aa_grid jittered samples
+constexpr int aa_threshold = 24;
+constexpr int aa_grid_default = 2;
+
+// PLOT_DISTANCE: the render kernels also carry dz/dc and fill Window::distance, escaped pixels closer
+// than boundary_width pixels to the set are darkened so thin filaments stay visible
+#ifdef PLOT_DISTANCE
+constexpr bool distance_estimation = true;
+#else
+constexpr bool distance_estimation = false;
+#endif
+constexpr float boundary_width = 1.f;
+
+// default view, headless zoom 1 has this width and is centered on the same point
+constexpr double view_center_x = -0.6;
+constexpr double view_center_y = 0.0;
+constexpr double view_width = 3.2;
 
 std::condition_variable cv;
 std::mutex mtx;
+// guards App::frame_stats, mtx is held by the render thread for the whole render
+std::mutex stats_mtx;
+// set by the main thread on new input in budget mode, the workers stop pulling tiles and the render returns early
+std::atomic<bool> render_cancel = false;
+// last limit the render thread picked with auto max_iter, the main thread takes it into App::max_iter
+// at the start of a frame. The render thread never writes App::max_iter itself.
+std::atomic<uint64_t> auto_max_iter = 0;
+
+// where the user looks, as a fraction of the view: x in the upper 32 bits, y in the lower, both floats.
+// Tiles nearest to it are rendered first, the main thread moves it with the mouse.
+constexpr uint64_t pack_focus(float x, float y) {
+    return (uint64_t)std::bit_cast<uint32_t>(x) << 32 | std::bit_cast<uint32_t>(y);
+}
+
+std::atomic<uint64_t> render_focus = pack_focus(0.5f, 0.5f);
 
 bool threads_running = true;
 
@@ -37,18 +106,172 @@ enum ComputeMode {
     MPFR
 };
 
-struct Vector2D {
-    double x;
-    double y;
+// how a smooth iteration count picks its palette entry
+enum ColorMapping {
+    COLOR_MODULO,
+    COLOR_LOG,
+    COLOR_HISTOGRAM,
+    COLOR_MAPPING_COUNT
+};
+
+const char* color_mapping_names[COLOR_MAPPING_COUNT] = {"modulo", "log", "histogram"};
+
+// how the scalar kernels walk a row: one pixel at a time or several orbits interleaved
+enum OrbitKernel {
+    KERNEL_PLAIN,
+    KERNEL_INTERLEAVED,
+    KERNEL_COUNT
+};
+
+const char* kernel_names[KERNEL_COUNT] = {"plain", "interleaved"};
+
+// how a tile is covered: every pixel, solid guessing that fills cells whose border and middle cross are inside
+// (a heuristic), or blocks that interval arithmetic proves inside
+enum RenderStrategy {
+    STRATEGY_FULL,
+    STRATEGY_GUESS,
+    STRATEGY_CERTIFY,
+    STRATEGY_COUNT
+};
+
+const char* strategy_names[STRATEGY_COUNT] = {"full", "guess", "certify"};
+
+// inside pixels: run to max_iter, or stop once the orbit is on an attracting cycle, and with color
+// also shade them by period and multiplier
+enum InteriorMode {
+    INTERIOR_OFF,
+    INTERIOR_DETECT,
+    INTERIOR_COLOR,
+    INTERIOR_COUNT
+};
+
+const char* interior_names[INTERIOR_COUNT] = {"off", "detect", "color"};
+
+template <typename T>
+struct Vector2T {
+    T x;
+    T y;
+};
+
+template <typename T>
+struct RectangleT {
+    T x;
+    T y;
+    T width;
+    T height;
 };
 
-struct RectangleD {
-    double x;
-    double y;
-    double width;
-    double height;
+using Vector2D = Vector2T<double>;
+using RectangleD = RectangleT<double>;
+
+// unevaluated sum hi + lo, about 106 bits of mantissa with the exponent range of double.
+// Needs strict IEEE double math, no -ffast-math.
+struct DoubleDouble {
+    double hi;
+    double lo;
+
+    DoubleDouble() = default;
+    DoubleDouble(double value) : hi(value), lo(0) {}
+    DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+};
+
+// hi + lo with |lo| <= ulp(hi) / 2, needs |a| >= |b|
+inline DoubleDouble quick_two_sum(double a, double b) {
+    double sum = a + b;
+    return {sum, b - (sum - a)};
+}
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) {
+    double sum = a.hi + b.hi;
+    double b_virtual = sum - a.hi;
+    double error = (a.hi - (sum - b_virtual)) + (b.hi - b_virtual);
+    return quick_two_sum(sum, error + a.lo + b.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a) {
+    return {-a.hi, -a.lo};
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) {
+    return a + -b;
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) {
+    double product = a.hi * b.hi;
+    double error = std::fma(a.hi, b.hi, -product);
+    return quick_two_sum(product, error + a.hi * b.lo + a.lo * b.hi);
+}
+
+inline DoubleDouble operator/(const DoubleDouble& a, double b) {
+    double q1 = a.hi / b;
+    DoubleDouble rest = a - DoubleDouble(q1) * b;
+    return quick_two_sum(q1, rest.hi / b);
+}
+
+inline bool operator>(const DoubleDouble& a, const DoubleDouble& b) {
+    return a.hi > b.hi || (a.hi == b.hi && a.lo > b.lo);
+}
+
+// false for nan, like double
+inline bool operator<=(const DoubleDouble& a, const DoubleDouble& b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo <= b.lo);
+}
+
+template <typename T>
+double to_double(const T& value) {
+    return (double)value;
+}
+
+inline double to_double(const DoubleDouble& value) {
+    return value.hi + value.lo;
+}
+
+template <typename T>
+Vector2D to_double(const Vector2T<T>& point) {
+    return {to_double(point.x), to_double(point.y)};
+}
+
+// number type of the render kernel, auto picks the cheapest one that resolves the pixel spacing
+enum ScalarType {
+    SCALAR_AUTO,
+    SCALAR_FLOAT,
+    // float until the escape is certain, then double for the pixels that are left
+    SCALAR_FLOAT_DOUBLE,
+    SCALAR_DOUBLE,
+    SCALAR_LONG_DOUBLE,
+    SCALAR_DOUBLE_DOUBLE,
+    SCALAR_MPFR,
+    SCALAR_COUNT
 };
 
+const char* scalar_names[SCALAR_COUNT] = {"auto", "float", "float-double", "double", "long-double", "double-double", "mpfr"};
+constexpr int scalar_digits[SCALAR_COUNT] = {0, std::numeric_limits<float>::digits, std::numeric_limits<double>::digits,
+                                             std::numeric_limits<double>::digits, std::numeric_limits<long double>::digits,
+                                             106, float_precision};
+// mantissa bits kept below the pixel spacing, so neither the coordinates nor the orbits visibly quantize
+constexpr int scalar_guard_bits = 10;
+// float-double: most iterations of the float stage. Its error bound grows like dz/dc, so escapes a few
+// pixels from the set are still certain after this many
+constexpr int float_stage_iterations = 64;
+// the float stage only beats the scalar double loop with 8 float lanes, auto skips it below that
+#if defined(__AVX__)
+constexpr bool wide_float_vectors = true;
+#else
+constexpr bool wide_float_vectors = false;
+#endif
+
+// log2_extent: largest coordinate of the view (at least 2, |z| goes up to there), log2_unit: pixel spacing.
+// Double mode only has the view in double, so nothing past double helps there.
+ScalarType pick_scalar(double log2_extent, double log2_unit, ComputeMode compute_mode) {
+    double bits = log2_extent - log2_unit + scalar_guard_bits;
+    ScalarType last = compute_mode == MPFR ? SCALAR_MPFR : SCALAR_DOUBLE;
+    for (int type = SCALAR_FLOAT; type < last; ++type) {
+        if (type == SCALAR_FLOAT_DOUBLE && !wide_float_vectors) continue;
+        if (scalar_digits[type] >= bits) return (ScalarType)type;
+    }
+    return last;
+}
+
 struct Vector2AP {
     mpfr_t x;
     mpfr_t y;
@@ -89,11 +312,19 @@ struct MandelbrotVectors {
     Vector2AP z;
     Vector2AP square;
     mpfr_t tmp;
+    // distance estimation only
+    Vector2AP dz;
+    mpfr_t dz_tmp;
+    // cycle detection only
+    Vector2AP cycle_z;
 
     void init() {
         z.init();
         square.init();
         mpfr_init(tmp);
+        dz.init();
+        mpfr_init(dz_tmp);
+        cycle_z.init();
     }
 };
 
@@ -101,6 +332,191 @@ struct MandelbrotVectors {
 DrawVectors thread_draw_vectors[max_threads] = {0};
 MandelbrotVectors thread_mandelbrot_vectors[max_threads] = {0};
 
+// counters of one render thread, each worker only writes its own entry, own cache line
+struct alignas(64) ThreadStats {
+    uint64_t pixels;
+    uint64_t iterations;
+    uint64_t escaped;
+    uint64_t max_iter_pixels;
+    // inside, stopped on an attracting cycle before max_iter
+    uint64_t cycle_pixels;
+    uint64_t aa_pixels;
+    // filled by solid guessing or certification, not in pixels
+    uint64_t guessed_pixels;
+    double seconds;
+
+    void count(uint64_t n, uint64_t max_iter) {
+        ++pixels;
+        if (n > 0) {
+            ++escaped;
+            iterations += n;
+        } else {
+            ++max_iter_pixels;
+            iterations += max_iter;
+        }
+    }
+
+    void count_cycle(uint64_t cycle_iterations) {
+        ++pixels;
+        ++cycle_pixels;
+        iterations += cycle_iterations;
+    }
+
+    void add(const ThreadStats& other) {
+        pixels += other.pixels;
+        iterations += other.iterations;
+        escaped += other.escaped;
+        max_iter_pixels += other.max_iter_pixels;
+        cycle_pixels += other.cycle_pixels;
+        aa_pixels += other.aa_pixels;
+        guessed_pixels += other.guessed_pixels;
+        seconds += other.seconds;
+    }
+};
+
+ThreadStats thread_stats[max_threads] = {0};
+
+#ifdef PLOT_TRACE
+// Scoped trace zones for chrome://tracing / Perfetto. Every thread writes into its own ring
+// without locks, only taking and returning a ring goes through trace_mtx. Rings of finished
+// threads are reused, so the short lived strip workers don't pile up rings.
+struct TraceEvent {
+    const char* name;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+constexpr uint64_t trace_ring_size = 1 << 16;
+
+struct TraceRing {
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(trace_ring_size);
+    std::atomic<uint64_t> head = 0;
+    const char* thread_name = "worker";
+};
+
+std::mutex trace_mtx;
+std::vector<std::unique_ptr<TraceRing>> trace_rings;
+std::vector<TraceRing*> free_trace_rings;
+const auto trace_epoch = std::chrono::steady_clock::now();
+
+struct TraceRingHandle {
+    TraceRing* ring = nullptr;
+
+    TraceRing& get() {
+        if (ring) return *ring;
+        std::lock_guard<std::mutex> lock(trace_mtx);
+        if (free_trace_rings.empty()) {
+            trace_rings.push_back(std::make_unique<TraceRing>());
+            ring = trace_rings.back().get();
+        } else {
+            ring = free_trace_rings.back();
+            ring->thread_name = "worker";
+            free_trace_rings.pop_back();
+        }
+        return *ring;
+    }
+
+    ~TraceRingHandle() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(trace_mtx);
+        free_trace_rings.push_back(ring);
+    }
+};
+
+thread_local TraceRingHandle trace_ring;
+
+int64_t trace_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+struct TraceZone {
+    const char* name;
+    int64_t begin_ns;
+
+    TraceZone(const char* name) : name(name), begin_ns(trace_now()) {}
+
+    ~TraceZone() {
+        TraceRing& ring = trace_ring.get();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        ring.events[head % trace_ring_size] = {name, begin_ns, trace_now()};
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+};
+
+void trace_thread_name(const char* name) {
+    trace_ring.get().thread_name = name;
+}
+
+// events still being written while dumping can come out torn, dump from a quiet point if that matters
+bool write_trace_json(const char* path) {
+    FILE* file = std::fopen(path, "w");
+    if (!file) return false;
+
+    std::lock_guard<std::mutex> lock(trace_mtx);
+    std::println(file, "{{\"traceEvents\": [");
+    bool first = true;
+    for (uint64_t tid = 0; tid < trace_rings.size(); ++tid) {
+        const TraceRing& ring = *trace_rings[tid];
+        std::print(file, "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{} {}\"}}}}",
+                   first ? "" : ",\n", tid, ring.thread_name, tid);
+        first = false;
+
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t begin = head > trace_ring_size ? head - trace_ring_size : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            const TraceEvent& event = ring.events[i % trace_ring_size];
+            std::print(file, ",\n{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                       event.name, tid, event.begin_ns / 1000.0, (event.end_ns - event.begin_ns) / 1000.0);
+        }
+    }
+    std::println(file, "\n]}}");
+    std::fclose(file);
+    return true;
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_THREAD_NAME(name)
+#endif
+
+// thread_stats of one render summed up, thread_seconds is the busy time per render thread and
+// tile_seconds the time per tile, for load balance
+struct FrameStats {
+    uint64_t frame = 0;
+    uint64_t max_iter = 0;
+    double seconds = 0;
+    uint64_t pixels = 0;
+    uint64_t iterations = 0;
+    uint64_t escaped = 0;
+    uint64_t max_iter_pixels = 0;
+    uint64_t cycle_pixels = 0;
+    uint64_t aa_pixels = 0;
+    // copied from the other side of the real axis, not in pixels
+    uint64_t mirrored_pixels = 0;
+    // filled inside by solid guessing or certification, not in pixels either
+    uint64_t guessed_pixels = 0;
+    ScalarType scalar = SCALAR_DOUBLE;
+    std::vector<double> thread_seconds;
+    std::vector<double> tile_seconds;
+
+    // busiest thread over the mean thread, 1 is perfectly balanced
+    double load_imbalance() const {
+        if (thread_seconds.empty()) return 1.0;
+        double sum = 0;
+        double slowest = 0;
+        for (double seconds : thread_seconds) {
+            sum += seconds;
+            slowest = std::max(slowest, seconds);
+        }
+        double mean = sum / thread_seconds.size();
+        return mean > 0 ? slowest / mean : 1.0;
+    }
+};
+
 Vector2AP temp;
 mpfr_t dif_halved;
 mpfr_t tmp;
@@ -172,27 +588,333 @@ void center_on_point(const Vector2AP& point, RectangleAP& rec) {
     mpfr_add(rec.y, point.y, tmp, MPFR_RNDN);
 }
 
-uint64_t in_mandelbrot_set(const Vector2D& point, uint64_t max_iter) {
-    double max_dist = 2.f;
+// a few steps past the escape, |z|^2 of z_{n+2} so smooth_iteration has no jumps between bands
+double escape_mag_squared(Vector2D z, const Vector2D& c, int steps) {
+    for (int i = 0; i < steps; ++i) {
+        double x = z.x * z.x - z.y * z.y + c.x;
+        z.y = 2.0 * z.x * z.y + c.y;
+        z.x = x;
+    }
+    return z.x * z.x + z.y * z.y;
+}
 
-    if (point.x * point.x + point.y * point.y > max_dist * max_dist) return 1;
-    uint64_t n = 0;
+// continuous iteration count from the escape index n and |z_{n+2}|^2, lies in [n, n + 1]
+float smooth_iteration(uint64_t n, double mag_squared) {
+    double nu = n + 3.0 - std::log2(0.5 * std::log2(mag_squared));
+    if (!std::isfinite(nu)) return n;
+    return nu;
+}
+
+// the estimate only holds once |z| is large, escaped orbits are run on until here
+constexpr double distance_bailout = 1e6;
+
+// lower bound for the distance of an escaped point to the set, from z and dz/dc of the same step.
+// |z| ln|z| / |dz| is the usual estimate, the true distance is at least a quarter of twice that.
+double exterior_distance(Vector2D z, Vector2D dz, const Vector2D& c) {
+    while (z.x * z.x + z.y * z.y < distance_bailout * distance_bailout) {
+        double dz_x = 2.0 * (z.x * dz.x - z.y * dz.y) + 1.0;
+        dz.y = 2.0 * (z.x * dz.y + z.y * dz.x);
+        dz.x = dz_x;
+        double z_x = z.x * z.x - z.y * z.y + c.x;
+        z.y = 2.0 * z.x * z.y + c.y;
+        z.x = z_x;
+    }
+    double z_abs = std::hypot(z.x, z.y);
+    return 0.5 * z_abs * std::log(z_abs) / std::hypot(dz.x, dz.y);
+}
+
+// same with dz/dc in MPFR, it grows like the zoom. z and c are only needed in double past the escape.
+double exterior_distance(Vector2D z, Vector2AP& dz, const Vector2D& c, mpfr_t& tmp, mpfr_t& dz_tmp) {
+    while (z.x * z.x + z.y * z.y < distance_bailout * distance_bailout) {
+        mpfr_mul_d(tmp, dz.y, z.x, MPFR_RNDN);
+        mpfr_mul_d(dz_tmp, dz.x, z.y, MPFR_RNDN);
+        mpfr_add(tmp, tmp, dz_tmp, MPFR_RNDN);
+
+        mpfr_mul_d(dz_tmp, dz.y, z.y, MPFR_RNDN);
+        mpfr_mul_d(dz.x, dz.x, z.x, MPFR_RNDN);
+        mpfr_sub(dz.x, dz.x, dz_tmp, MPFR_RNDN);
+        mpfr_mul_2ui(dz.x, dz.x, 1, MPFR_RNDN);
+        mpfr_add_ui(dz.x, dz.x, 1, MPFR_RNDN);
+        mpfr_mul_2ui(dz.y, tmp, 1, MPFR_RNDN);
+
+        double z_x = z.x * z.x - z.y * z.y + c.x;
+        z.y = 2.0 * z.x * z.y + c.y;
+        z.x = z_x;
+    }
+    double z_abs = std::hypot(z.x, z.y);
+    mpfr_hypot(tmp, dz.x, dz.y, MPFR_RNDN);
+    mpfr_d_div(tmp, 0.5 * z_abs * std::log(z_abs), tmp, MPFR_RNDN);
+    return mpfr_get_d(tmp, MPFR_RNDN);
+}
+
+// iterations per block of iterate_orbit
+constexpr uint64_t bailout_block = 8;
+
+// one step z -> z^2 + c, dz -> 2 z dz + 1 first with with_distance
+template <typename T, bool with_distance>
+void orbit_step(Vector2T<T>& z, Vector2D& dz, const Vector2T<T>& point, T& x_squared, T& y_squared) {
+    const T two = 2.0;
+    x_squared = z.x * z.x;
+    y_squared = z.y * z.y;
+
+    if constexpr (with_distance) {
+        // dz_{n+1} = 2 z_n dz_n + 1
+        Vector2D z_d = to_double(z);
+        double dz_x = 2.0 * (z_d.x * dz.x - z_d.y * dz.y) + 1.0;
+        dz.y = 2.0 * (z_d.x * dz.y + z_d.y * dz.x);
+        dz.x = dz_x;
+    }
 
-    Vector2D z = {0};
-    double x_squared, y_squared;
+    z.y = two * z.x * z.y + point.y;
+    z.x = x_squared - y_squared + point.x;
+}
+
+// attracting cycle an inside orbit ended on. period 0 = none found, multiplier is |(f^p)'| on the cycle
+// and iterations where the orbit was stopped
+struct OrbitCycle {
+    uint64_t period = 0;
+    double multiplier = 0;
+    uint64_t iterations = 0;
+};
+
+// how close in double an orbit has to come back to count as a return, float orbits jitter by more
+template <typename T>
+constexpr double cycle_epsilon = std::is_same_v<T, float> ? 1e-5 : 1e-12;
+
+// z came back to within cycle_epsilon of where it was q steps ago. Walks up to q steps on from z, the
+// first return is the period p, and multiplies up (f^p)'(z) = prod 2 z_i on the way. Below 1 the cycle is
+// attracting and c is inside for any max_iter, above it was a near miss.
+template <typename T>
+bool attracting_cycle(const Vector2T<T>& c, Vector2T<T> z, uint64_t q, OrbitCycle& cycle) {
+    const double epsilon_squared = cycle_epsilon<T> * cycle_epsilon<T>;
+    Vector2D start = to_double(z);
+    Vector2D derivative = {1.0, 0.0};
+    T x_squared, y_squared;
+    Vector2D dz = {0};
+
+    for (uint64_t p = 1; p <= q; ++p) {
+        Vector2D z_d = to_double(z);
+        double derivative_x = 2.0 * (z_d.x * derivative.x - z_d.y * derivative.y);
+        derivative.y = 2.0 * (z_d.x * derivative.y + z_d.y * derivative.x);
+        derivative.x = derivative_x;
+        orbit_step<T, false>(z, dz, c, x_squared, y_squared);
+
+        z_d = to_double(z);
+        double dx = z_d.x - start.x;
+        double dy = z_d.y - start.y;
+        if (dx * dx + dy * dy < epsilon_squared) {
+            double multiplier = std::hypot(derivative.x, derivative.y);
+            if (!(multiplier < 1.0)) return false;
+            cycle.period = p;
+            cycle.multiplier = multiplier;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs the orbit on from z_n, returns the first n with |z_n| > 2 (z is then z_{n+1}) or 0 at max_iter.
+// The bailout is only checked once per bailout_block steps: with |c| <= 2 an orbit past 2 never comes
+// back, so |z| > 2 after the block means it escaped somewhere in there. It may have overflowed to inf
+// or nan by then, hence !(mag <= 4). The block is then stepped again from its start with a check per step,
+// the same operations in the same order give the same escape index as checking every step.
+// with_cycles also compares the block ends to a saved one, moved to every power of two'th block (Brent).
+// A return is a multiple of the period, attracting_cycle finds the period and stops the orbit as inside.
+template <typename T, bool with_distance = false, bool with_cycles = false>
+uint64_t iterate_orbit(const Vector2T<T>& point, Vector2T<T>& z_n, Vector2D& dz_n, uint64_t n, uint64_t max_iter,
+                       OrbitCycle* cycle = nullptr) {
+    const T max_dist_squared = 4.0;
+    // locals, through the references every step would go to memory
+    const Vector2T<T> c = point;
+    Vector2T<T> z = z_n;
+    Vector2D dz = dz_n;
+    T x_squared, y_squared;
+
+    [[maybe_unused]] Vector2D trap = to_double(z);
+    [[maybe_unused]] uint64_t trap_n = n;
+    [[maybe_unused]] uint64_t blocks = 0;
+    [[maybe_unused]] uint64_t trap_blocks = 1;
+
+    while (n + bailout_block <= max_iter) {
+        Vector2T<T> block_z = z;
+        Vector2D block_dz = dz;
+        for (uint64_t i = 0; i < bailout_block; ++i) {
+            orbit_step<T, with_distance>(z, dz, c, x_squared, y_squared);
+        }
+        T mag = z.x * z.x + z.y * z.y;
+        if (!(mag <= max_dist_squared)) {
+            z = block_z;
+            dz = block_dz;
+            break;
+        }
+        n += bailout_block;
+
+        if constexpr (with_cycles) {
+            Vector2D z_d = to_double(z);
+            double dx = z_d.x - trap.x;
+            double dy = z_d.y - trap.y;
+            if (dx * dx + dy * dy < cycle_epsilon<T> * cycle_epsilon<T> && attracting_cycle(c, z, n - trap_n, *cycle)) {
+                cycle->iterations = n;
+                z_n = z;
+                dz_n = dz;
+                return 0;
+            }
+            if (++blocks == trap_blocks) {
+                trap = z_d;
+                trap_n = n;
+                trap_blocks *= 2;
+            }
+        }
+    }
 
+    uint64_t escaped = 0;
     for (; n < max_iter; ++n) {
-        x_squared = z.x * z.x;
-        y_squared = z.y * z.y;
+        orbit_step<T, with_distance>(z, dz, c, x_squared, y_squared);
+        // z is already z_{n+1}
+        if (x_squared + y_squared > max_dist_squared) {
+            escaped = n;
+            break;
+        }
+    }
+    z_n = z;
+    dz_n = dz;
+    return escaped;
+}
+
+// T is float, double, long double or DoubleDouble. with_distance also iterates dz/dc and writes the
+// exterior distance of escaped points in graph units, without it the loop is the same as before.
+// dz only needs range, not precision, it stays in double. Everything past the escape runs in double.
+// with_cycles stops inside orbits on an attracting cycle early and fills cycle, see iterate_orbit.
+template <typename T, bool with_distance = false, bool with_cycles = false>
+uint64_t in_mandelbrot_set(const Vector2T<T>& point, uint64_t max_iter, double& mag_squared, double* distance = nullptr,
+                           OrbitCycle* cycle = nullptr) {
+    const T max_dist_squared = 4.0;
+
+    if (point.x * point.x + point.y * point.y > max_dist_squared) {
+        // z_1 = point
+        Vector2D c = to_double(point);
+        mag_squared = escape_mag_squared(c, c, 2);
+        // dz_1 = 1
+        if constexpr (with_distance) *distance = exterior_distance(c, {1.0, 0.0}, c);
+        return 1;
+    }
+    Vector2T<T> z = {0.0, 0.0};
+    Vector2D dz = {0};
+    uint64_t n = iterate_orbit<T, with_distance, with_cycles>(point, z, dz, 0, max_iter, cycle);
+    if (n == 0) return 0;
+
+    Vector2D c = to_double(point);
+    mag_squared = escape_mag_squared(to_double(z), c, 1);
+    if constexpr (with_distance) *distance = exterior_distance(to_double(z), dz, c);
+    return n;
+}
 
-        z.y = (double)2.f * z.x * z.y + point.y; 
-        z.x = x_squared - y_squared + point.x; 
+// orbits in flight per row in the interleaved kernel. x87 long double only has 8 stack registers,
+// more than 2 orbits spill every step
+template <typename T>
+constexpr int orbit_lanes = std::is_same_v<T, long double> ? 2 : 4;
+// two-phase render: iterations of the first pass over the tiles, the survivors go on after it in chunks
+constexpr uint64_t phase_one_iterations = 256;
+constexpr uint64_t survivor_chunk = 1024;
+
+// an orbit of the interleaved kernel, z = z_n. Starts at z = 0, n = 0, the two-phase render keeps the ones
+// that outlive the first phase and continues them from here
+template <typename T>
+struct Orbit {
+    Vector2T<T> c;
+    Vector2T<T> z;
+    uint64_t n;
+    // y * width + x in graph_image
+    uint64_t pixel;
+};
 
-        if (x_squared + y_squared > max_dist * max_dist) {
-            return n;
+// in_mandelbrot_set for count orbits at once. One orbit waits on its own previous step the whole time,
+// orbit_lanes<T> independent ones fill those waits. All lanes step a bailout_block together, a lane that ends
+// the block outside or gets near max_iter is finished alone by iterate_orbit from the block start
+// (same steps, same result as in_mandelbrot_set) and takes the next orbit. Idle lanes run c = 0, which
+// stays at 0. An orbit still inside at max_iter keeps its z and n = max_iter, so it can go on later.
+template <typename T>
+void interleaved_in_mandelbrot_set(Orbit<T>* orbits, int count, uint64_t max_iter, uint64_t* iterations, double* mag_squared) {
+    const T max_dist_squared = 4.0;
+    Vector2T<T> z[orbit_lanes<T>];
+    Vector2T<T> c[orbit_lanes<T>];
+    uint64_t n[orbit_lanes<T>];
+    // index into orbits, -1 for idle
+    int slot[orbit_lanes<T>];
+
+    int next = 0;
+    auto refill = [&](int lane) {
+        slot[lane] = -1;
+        z[lane] = c[lane] = {0.0, 0.0};
+        n[lane] = 0;
+        while (next < count) {
+            int i = next++;
+            const Orbit<T>& orbit = orbits[i];
+            if (orbit.n == 0 && orbit.c.x * orbit.c.x + orbit.c.y * orbit.c.y > max_dist_squared) {
+                // z_1 = c
+                Vector2D c_d = to_double(orbit.c);
+                iterations[i] = 1;
+                mag_squared[i] = escape_mag_squared(c_d, c_d, 2);
+                continue;
+            }
+            slot[lane] = i;
+            c[lane] = orbit.c;
+            z[lane] = orbit.z;
+            n[lane] = orbit.n;
+            return;
+        }
+    };
+    auto finish = [&](int lane) {
+        int i = slot[lane];
+        Vector2D dz = {0};
+        iterations[i] = iterate_orbit(c[lane], z[lane], dz, n[lane], max_iter);
+        if (iterations[i] > 0) {
+            mag_squared[i] = escape_mag_squared(to_double(z[lane]), to_double(c[lane]), 1);
+        } else {
+            orbits[i].z = z[lane];
+            orbits[i].n = max_iter;
+        }
+    };
+
+    int busy = 0;
+    for (int lane = 0; lane < orbit_lanes<T>; ++lane) {
+        refill(lane);
+        busy += slot[lane] >= 0;
+    }
+
+    while (busy > 0) {
+        for (int lane = 0; lane < orbit_lanes<T>; ++lane) {
+            while (slot[lane] >= 0 && n[lane] + bailout_block > max_iter) {
+                finish(lane);
+                refill(lane);
+                busy -= slot[lane] < 0;
+            }
+        }
+
+        Vector2T<T> block_z[orbit_lanes<T>];
+        for (int lane = 0; lane < orbit_lanes<T>; ++lane) block_z[lane] = z[lane];
+        for (uint64_t i = 0; i < bailout_block; ++i) {
+            for (int lane = 0; lane < orbit_lanes<T>; ++lane) {
+                T x_squared = z[lane].x * z[lane].x;
+                T y_squared = z[lane].y * z[lane].y;
+                z[lane].y = T(2.0) * z[lane].x * z[lane].y + c[lane].y;
+                z[lane].x = x_squared - y_squared + c[lane].x;
+            }
+        }
+
+        for (int lane = 0; lane < orbit_lanes<T>; ++lane) {
+            if (slot[lane] < 0) continue;
+            T mag = z[lane].x * z[lane].x + z[lane].y * z[lane].y;
+            if (mag <= max_dist_squared) {
+                n[lane] += bailout_block;
+                continue;
+            }
+            z[lane] = block_z[lane];
+            finish(lane);
+            refill(lane);
+            busy -= slot[lane] < 0;
         }
     }
-    return 0;
 }
 
 // screen_rec = graph_rec also ist screen point hier ok, aber falls es sich ändert muss man noch zusätzlich in onscreen_graph_space umrechnen
@@ -233,7 +955,50 @@ void to_graph(Vector2AP& point, RectangleD graph_rec, const RectangleAP& mandelb
 
 
 
-int in_mandelbrot_set(const Vector2AP& point, MandelbrotVectors& vectors, uint64_t max_iter) {
+// attracting_cycle for mpfr orbits, steps a copy of z in vectors.cycle_z with vectors.square as scratch.
+// The returns are compared in double like the other types.
+bool attracting_cycle(const Vector2AP& c, const Vector2AP& z_start, uint64_t q, MandelbrotVectors& vectors, OrbitCycle& cycle) {
+    const double epsilon_squared = cycle_epsilon<double> * cycle_epsilon<double>;
+    Vector2AP& z = vectors.cycle_z;
+    Vector2AP& square = vectors.square;
+    mpfr_set(z.x, z_start.x, MPFR_RNDN);
+    mpfr_set(z.y, z_start.y, MPFR_RNDN);
+    Vector2D start = {mpfr_get_d(z.x, MPFR_RNDN), mpfr_get_d(z.y, MPFR_RNDN)};
+    Vector2D derivative = {1.0, 0.0};
+
+    for (uint64_t p = 1; p <= q; ++p) {
+        Vector2D z_d = {mpfr_get_d(z.x, MPFR_RNDN), mpfr_get_d(z.y, MPFR_RNDN)};
+        double derivative_x = 2.0 * (z_d.x * derivative.x - z_d.y * derivative.y);
+        derivative.y = 2.0 * (z_d.x * derivative.y + z_d.y * derivative.x);
+        derivative.x = derivative_x;
+
+        mpfr_mul(square.x, z.x, z.x, MPFR_RNDN);
+        mpfr_mul(square.y, z.y, z.y, MPFR_RNDN);
+        mpfr_mul(z.y, z.x, z.y, MPFR_RNDN);
+        mpfr_mul_2ui(z.y, z.y, 1, MPFR_RNDN);
+        mpfr_add(z.y, z.y, c.y, MPFR_RNDN);
+        mpfr_sub(z.x, square.x, square.y, MPFR_RNDN);
+        mpfr_add(z.x, z.x, c.x, MPFR_RNDN);
+
+        double dx = mpfr_get_d(z.x, MPFR_RNDN) - start.x;
+        double dy = mpfr_get_d(z.y, MPFR_RNDN) - start.y;
+        if (dx * dx + dy * dy < epsilon_squared) {
+            double multiplier = std::hypot(derivative.x, derivative.y);
+            if (!(multiplier < 1.0)) return false;
+            cycle.period = p;
+            cycle.multiplier = multiplier;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the steps past the escape run in double, |z| > 2 there and the low digits of point don't show in the color.
+// The distance ends up in double and underflows past zoom 1e300. with_cycles checks every step for a
+// return to the saved z, see iterate_orbit.
+template <bool with_distance = false, bool with_cycles = false>
+int in_mandelbrot_set(const Vector2AP& point, MandelbrotVectors& vectors, uint64_t max_iter, double& mag_squared, double* distance = nullptr,
+                      OrbitCycle* cycle = nullptr) {
     double max_dist = 2.f;
     mpfr_t& x_sqared = vectors.square.x;
     mpfr_t& y_sqared = vectors.square.y;
@@ -244,7 +1009,16 @@ int in_mandelbrot_set(const Vector2AP& point, MandelbrotVectors& vectors, uint64
     mpfr_add(x_sqared, x_sqared, y_sqared, MPFR_RNDN);
 
 
-    if (mpfr_cmp_d(x_sqared, max_dist * max_dist) > 0) return 1;
+    Vector2D c = {mpfr_get_d(point.x, MPFR_RNDN), mpfr_get_d(point.y, MPFR_RNDN)};
+    if (mpfr_cmp_d(x_sqared, max_dist * max_dist) > 0) {
+        mag_squared = escape_mag_squared(c, c, 2);
+        if constexpr (with_distance) {
+            mpfr_set_d(vectors.dz.x, 1.0, MPFR_RNDN);
+            mpfr_set_d(vectors.dz.y, 0.0, MPFR_RNDN);
+            *distance = exterior_distance(c, vectors.dz, c, vectors.tmp, vectors.dz_tmp);
+        }
+        return 1;
+    }
 
     uint64_t n = 0;
 
@@ -255,12 +1029,37 @@ int in_mandelbrot_set(const Vector2AP& point, MandelbrotVectors& vectors, uint64
     mpfr_set_d(x_sqared, 0.f, MPFR_RNDN);
     mpfr_set_d(y_sqared, 0.f, MPFR_RNDN);
 
+    Vector2AP& dz = vectors.dz;
+    if constexpr (with_distance) {
+        mpfr_set_d(dz.x, 0.f, MPFR_RNDN);
+        mpfr_set_d(dz.y, 0.f, MPFR_RNDN);
+    }
+
     //mpfr_t& x_tmp = vectors.tmp; 
 
+    [[maybe_unused]] Vector2D trap = {0.0, 0.0};
+    [[maybe_unused]] uint64_t trap_n = 0;
+    [[maybe_unused]] uint64_t trap_at = 1;
+
     for (; n < max_iter; ++n) {
         mpfr_mul(x_sqared, z.x, z.x, MPFR_RNDN);
         mpfr_mul(y_sqared, z.y, z.y, MPFR_RNDN);
 
+        if constexpr (with_distance) {
+            // dz_{n+1} = 2 z_n dz_n + 1
+            mpfr_t& dz_y = vectors.tmp;
+            mpfr_mul(dz_y, z.x, dz.y, MPFR_RNDN);
+            mpfr_mul(vectors.dz_tmp, z.y, dz.x, MPFR_RNDN);
+            mpfr_add(dz_y, dz_y, vectors.dz_tmp, MPFR_RNDN);
+
+            mpfr_mul(vectors.dz_tmp, z.x, dz.x, MPFR_RNDN);
+            mpfr_mul(dz.x, z.y, dz.y, MPFR_RNDN);
+            mpfr_sub(dz.x, vectors.dz_tmp, dz.x, MPFR_RNDN);
+            mpfr_mul_2ui(dz.x, dz.x, 1, MPFR_RNDN);
+            mpfr_add_ui(dz.x, dz.x, 1, MPFR_RNDN);
+            mpfr_mul_2ui(dz.y, dz_y, 1, MPFR_RNDN);
+        }
+
         //z.y = 2.f * z.x * z.y + point.y; 
         mpfr_mul(z.y, z.x, z.y, MPFR_RNDN);
         mpfr_mul_d(z.y, z.y, 2.f, MPFR_RNDN);
@@ -275,8 +1074,27 @@ int in_mandelbrot_set(const Vector2AP& point, MandelbrotVectors& vectors, uint64
         mpfr_add(x_sqared, x_sqared, y_sqared, MPFR_RNDN);
         int cmp = mpfr_cmp_d(x_sqared, max_dist * max_dist);
         if (cmp > 0) {
+            Vector2D z_d = {mpfr_get_d(z.x, MPFR_RNDN), mpfr_get_d(z.y, MPFR_RNDN)};
+            mag_squared = escape_mag_squared(z_d, c, 1);
+            if constexpr (with_distance) *distance = exterior_distance(z_d, dz, c, vectors.tmp, vectors.dz_tmp);
             return n;
         }
+
+        if constexpr (with_cycles) {
+            // z is z_{n+1}
+            Vector2D z_d = {mpfr_get_d(z.x, MPFR_RNDN), mpfr_get_d(z.y, MPFR_RNDN)};
+            double dx = z_d.x - trap.x;
+            double dy = z_d.y - trap.y;
+            if (dx * dx + dy * dy < cycle_epsilon<double> * cycle_epsilon<double> && attracting_cycle(point, z, n + 1 - trap_n, vectors, *cycle)) {
+                cycle->iterations = n + 1;
+                return 0;
+            }
+            if (n + 1 == trap_at) {
+                trap = z_d;
+                trap_n = n + 1;
+                trap_at *= 2;
+            }
+        }
     }
     return 0;
 }
@@ -291,11 +1109,163 @@ struct Mandelbrot {
     RectangleAP mandelbrot_rec_mpfr;
 };
 
+// palette_size rgb entries in 0..1, one turn around the hue circle starting at red.
+// Built on first use and read only afterwards, so all render threads share it.
+const std::vector<Vector3>& palette() {
+    static const std::vector<Vector3> lut = [] {
+        std::vector<Vector3> lut(palette_size);
+        Vector3 hsv = ColorToHSV(RED);
+        for (uint64_t i = 0; i < palette_size; ++i) {
+            Color color = ColorFromHSV(hsv.x, hsv.y, hsv.z);
+            lut[i] = {color.r / 255.f, color.g / 255.f, color.b / 255.f};
+            hsv.x += 360.f / palette_size;
+        }
+        return lut;
+    }();
+    return lut;
+}
+
+// t in [0, 1] is one turn of the palette, the last entry blends into the first
+Color palette_color(float t) {
+    const std::vector<Vector3>& lut = palette();
+    float position = (t - std::floor(t)) * palette_size;
+    uint64_t i = std::min<uint64_t>(position, palette_size - 1);
+    float frac = position - i;
+    const Vector3& a = lut[i];
+    const Vector3& b = lut[(i + 1) % palette_size];
+    return {(unsigned char)((a.x + (b.x - a.x) * frac) * 255.f + 0.5f),
+            (unsigned char)((a.y + (b.y - a.y) * frac) * 255.f + 0.5f),
+            (unsigned char)((a.z + (b.z - a.z) * frac) * 255.f + 0.5f), 255};
+}
+
+// smooth_n in [1, max_iter + 1], position is the fractional bin
+uint64_t histogram_bin(float smooth_n, uint64_t max_iter, float& position) {
+    position = std::log2(smooth_n) / std::log2(max_iter + 1.0) * histogram_bins;
+    position = std::clamp<float>(position, 0, histogram_bins);
+    return std::min<uint64_t>(position, histogram_bins - 1);
+}
+
+// Triple buffer between the render thread and the texture upload. The render thread keeps
+// stable (the newest finished pixels), brings back up to date and publishes it as pending.
+// The main thread swaps pending to front when it is newer than the last upload. Neither side
+// ever waits for the other and the upload never sees pixels that are still being written.
+//
+// Changes are tracked per render tile: stale[slot] marks tiles where a buffer is behind stable,
+// dirty[slot] the tiles the texture still needs once that buffer becomes front.
+struct FrameBuffers {
+    static constexpr uint32_t fresh = 4;
+
+    int width;
+    std::vector<Color> stable;
+    std::vector<Color> buffers[3];
+    std::vector<uint8_t> stale[3];
+    std::vector<uint8_t> dirty[3];
+    std::atomic<uint32_t> pending = 1;
+    uint32_t back = 0;
+    uint32_t front = 2;
+
+    FrameBuffers(int width, int height, Color color, uint64_t tile_count) : width(width) {
+        stable.assign((uint64_t)width * height, color);
+        for (int slot = 0; slot < 3; ++slot) {
+            buffers[slot] = stable;
+            stale[slot].assign(tile_count, 0);
+            dirty[slot].assign(tile_count, 0);
+        }
+    }
+
+    void copy_tile(std::vector<Color>& to, const Color* from, const RectangleD& tile) {
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            uint64_t row = (uint64_t)y * width + (int)tile.x;
+            std::memcpy(&to[row], &from[row], (int)tile.width * sizeof(Color));
+        }
+    }
+
+    bool tile_equal(const Color* a, const Color* b, const RectangleD& tile) {
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            uint64_t row = (uint64_t)y * width + (int)tile.x;
+            if (std::memcmp(&a[row], &b[row], (int)tile.width * sizeof(Color)) != 0) return false;
+        }
+        return true;
+    }
+
+    // render thread: take over finished tiles of the work image and hand out a new frame
+    void publish(const Image& work, const std::vector<RectangleD>& tiles, const std::vector<uint64_t>& tile_ids) {
+        const Color* pixels = (const Color*)work.data;
+        uint32_t last = pending.load(std::memory_order_acquire);
+
+        // if the main thread has not picked up the last publish yet, its tiles are still owed to the texture.
+        // If it picks it up right after this check the tiles are just uploaded twice.
+        std::vector<uint8_t>& mask = dirty[back];
+        if (last & fresh) {
+            mask = dirty[last & 3];
+        } else {
+            std::fill(mask.begin(), mask.end(), 0);
+        }
+
+        bool changed = false;
+        for (uint64_t tile_id : tile_ids) {
+            if (tile_equal(stable.data(), pixels, tiles[tile_id])) continue;
+            copy_tile(stable, pixels, tiles[tile_id]);
+            for (int slot = 0; slot < 3; ++slot) stale[slot][tile_id] = 1;
+            mask[tile_id] = 1;
+            changed = true;
+        }
+        if (!changed) return;
+
+        for (uint64_t tile_id = 0; tile_id < tiles.size(); ++tile_id) {
+            if (!stale[back][tile_id]) continue;
+            copy_tile(buffers[back], stable.data(), tiles[tile_id]);
+            stale[back][tile_id] = 0;
+        }
+
+        back = pending.exchange(back | fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    // main thread: true if front changed since the last call, front_dirty() then lists the changed tiles
+    bool acquire() {
+        if (!(pending.load(std::memory_order_acquire) & fresh)) return false;
+        front = pending.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const Color* front_data() const {
+        return buffers[front].data();
+    }
+
+    const std::vector<uint8_t>& front_dirty() const {
+        return dirty[front];
+    }
+};
+
+constexpr std::chrono::milliseconds publish_interval(16);
+
 struct Window {
     Rectangle graph_rec;
+    // work image, the render workers write here
     Image graph_image;
-
-    std::vector<Color> palette;
+    // only for the interactive window, headless renders read graph_image directly
+    std::unique_ptr<FrameBuffers> frame_buffers;
+
+    ColorMapping color_mapping = COLOR_MODULO;
+    // samples per side for edge pixels, 0 = no antialiasing
+    int aa_grid = 0;
+    // forced kernel number type, scalar_used is what the last render picked
+    ScalarType scalar = SCALAR_AUTO;
+    ScalarType scalar_used = SCALAR_DOUBLE;
+    OrbitKernel kernel = KERNEL_INTERLEAVED;
+    RenderStrategy strategy = STRATEGY_FULL;
+    InteriorMode interior = INTERIOR_OFF;
+    // fraction of the escaped pixels below each histogram bin, from the last finished render
+    std::vector<float> histogram_cdf;
+    // raw kernel result per pixel (0 = inside), row major like graph_image
+    std::vector<uint64_t> iterations;
+    // smooth_iteration per pixel (0 = inside, -(period + multiplier) = inside on a known attracting cycle)
+    std::vector<float> smooth;
+    // exterior distance estimate in pixels (0 = inside), only filled with distance_estimation
+    std::vector<float> distance;
+    // per row the row across the real axis it is copied from, -1 if it is computed. Empty = no mirroring
+    std::vector<int> mirror_source;
+    uint64_t mirrored_pixels = 0;
 
     Rectangle menu_rec = {0};
     Vector2 screen_size;
@@ -308,24 +1278,49 @@ struct Window {
 
     //std::vector<std::thread> render_jobs;
     //std::vector<uint64_t> threads_ready;
-    std::vector<RectangleD> draw_recs;
+    std::vector<RectangleD> tiles;
+    std::vector<double> tile_seconds;
+    std::vector<Color> tile_upload;
     std::jthread render_thread;
     bool thread_ready = true;
 
-    void fill_palette(uint64_t max_iter) {
-        Color start = RED;
-        Color end = BLACK;
-        Vector3 hsv = ColorToHSV(start);
+    Color pixel_color(float smooth_n, uint64_t max_iter) const {
+        if (smooth_n < 0 && interior == INTERIOR_COLOR) {
+            // hue per period, darker towards the edge of the component where |multiplier| gets to 1
+            float period = std::floor(-smooth_n);
+            float shade = 1.f - (-smooth_n - period);
+            Color color = palette_color(period * 0.618034f);
+            return {(unsigned char)(color.r * shade), (unsigned char)(color.g * shade), (unsigned char)(color.b * shade), 255};
+        }
+        if (smooth_n <= 0) return bg_color;
+
+        if (color_mapping == COLOR_MODULO) {
+            return palette_color(smooth_n / color_period);
 
-        palette.clear();
-        palette.reserve(max_iter);
-        palette.resize(max_iter);  
+        } else if (color_mapping == COLOR_HISTOGRAM && !histogram_cdf.empty()) {
+            float position;
+            uint64_t bin = histogram_bin(smooth_n, max_iter, position);
+            float below = histogram_cdf[bin];
+            return palette_color(below + (histogram_cdf[bin + 1] - below) * (position - bin));
+        }
+        // log, also histogram before the first histogram exists
+        return palette_color(std::log2(smooth_n) / log_color_period);
+    }
+
+    // color of a computed pixel, pixel_color plus the boundary shading of distance_estimation
+    Color pixel_color_at(uint64_t pixel, uint64_t max_iter) const {
+        return shade_boundary(pixel_color(smooth[pixel], max_iter), pixel);
+    }
 
-        for(int i = 0; i < max_iter; ++i) {
-            //palette[i] = ColorLerp(start, end, i / (float)max_iter);
-            palette[i] = (ColorFromHSV(hsv.x, hsv.y, hsv.z));
-            hsv.x += 360.f / max_iter;
-        }   
+    Color shade_boundary(Color color, uint64_t pixel) const {
+        if constexpr (distance_estimation) {
+            float d = distance[pixel];
+            if (d > 0 && d < boundary_width) {
+                float shade = std::sqrt(d / boundary_width);
+                return {(unsigned char)(color.r * shade), (unsigned char)(color.g * shade), (unsigned char)(color.b * shade), 255};
+            }
+        }
+        return color;
     }
 
     void draw_axis(RectangleD mandelbrot_rec, float thicc = 1.f, Color color = WHITE) {
@@ -399,59 +1394,1633 @@ struct Window {
 //    }
 
 
-    void draw_frame(Color tint) {
+    void draw_stats(const FrameStats& stats) {
+        float text_size = 20;
+        float x = 10;
+        float y = 10;
+        Color box = {0, 0, 0, 180};
+
+        double pixels = stats.pixels > 0 ? stats.pixels : 1;
+        const char* lines[] = {
+            TextFormat("frame %llu: %.1f ms, max_iter %llu, %s", (unsigned long long)stats.frame, stats.seconds * 1000.0, (unsigned long long)stats.max_iter, scalar_names[stats.scalar]),
+            TextFormat("%.1f Mpixels/s, %.1f Miterations/s", stats.pixels / stats.seconds / 1e6, stats.iterations / stats.seconds / 1e6),
+            TextFormat("escaped %.1f%%, at max_iter %.1f%%, cycles %.1f%%, aa %.1f%%, mirrored %llu, guessed %llu", 100.0 * stats.escaped / pixels, 100.0 * stats.max_iter_pixels / pixels, 100.0 * stats.cycle_pixels / pixels, 100.0 * stats.aa_pixels / pixels, (unsigned long long)stats.mirrored_pixels, (unsigned long long)stats.guessed_pixels),
+            TextFormat("threads %zu, tiles %zu, imbalance %.2f", stats.thread_seconds.size(), stats.tile_seconds.size(), stats.load_imbalance()),
+        };
+
+        DrawRectangle(x - 5, y - 5, 600, 4 * text_size + 70, box);
+        for (const char* line : lines) {
+            DrawText(line, x, y, text_size, WHITE);
+            y += text_size;
+        }
+
+        // one bar per thread, height relative to the busiest thread
+        double slowest = 0;
+        for (double seconds : stats.thread_seconds) slowest = std::max(slowest, seconds);
+        float bar_height = 50;
+        float bar_width = 400.f / std::max<uint64_t>(1, stats.thread_seconds.size());
+        for (uint64_t i = 0; i < stats.thread_seconds.size(); ++i) {
+            float height = slowest > 0 ? stats.thread_seconds[i] / slowest * bar_height : 0;
+            DrawRectangle(x + i * bar_width, y + 5 + bar_height - height, std::max(1.f, bar_width - 1), height, GREEN);
+        }
+    }
+
+    // UpdateTextureRec wants the rectangle packed, tile_upload holds one tile at a time
+    void upload_dirty_tiles() {
+        const std::vector<uint8_t>& dirty = frame_buffers->front_dirty();
+        const Color* pixels = frame_buffers->front_data();
+        uint64_t dirty_count = std::count(dirty.begin(), dirty.end(), 1);
+
+        // a mostly changed frame is cheaper in one call
+        if (dirty_count * 2 > tiles.size()) {
+            UpdateTexture(graph_texture, pixels);
+            return;
+        }
+
+        int width = graph_image.width;
+        for (uint64_t tile_id = 0; tile_id < tiles.size(); ++tile_id) {
+            if (!dirty[tile_id]) continue;
+            const RectangleD& tile = tiles[tile_id];
+            tile_upload.resize((uint64_t)tile.width * tile.height);
+            for (int y = 0; y < tile.height; ++y) {
+                std::memcpy(&tile_upload[(uint64_t)y * (int)tile.width], &pixels[(uint64_t)(tile.y + y) * width + (int)tile.x], (int)tile.width * sizeof(Color));
+            }
+            UpdateTextureRec(graph_texture, {(float)tile.x, (float)tile.y, (float)tile.width, (float)tile.height}, tile_upload.data());
+        }
+    }
+
+    void draw_frame(Color tint, const FrameStats* stats = nullptr) {
 
-        UpdateTexture(graph_texture, graph_image.data);
+        if (frame_buffers->acquire()) {
+            TRACE_ZONE("UpdateTexture");
+            upload_dirty_tiles();
+        }
         DrawTexturePro(graph_texture, graph_rec, {0, 0, (float)screen_size.x, (float)screen_size.y}, {0.f, 0.f}, 0.f, tint);
 
+        if (stats) draw_stats(*stats);
+
         DrawFPS(screen_size.x - 50, screen_size.y - 50);
+        TRACE_ZONE("EndDrawing");
         EndDrawing();
     }
 };
 
-void draw_mandelbrot_image(const RectangleD& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t thread_id) {
+// the view for the float-double kernel, coordinates are double
+struct MixedRectangle {
+    RectangleD rec;
+};
 
-    RectangleD& draw_rec = window.draw_recs[thread_id];
-    Vector2D graph_top_left = {draw_rec.x, draw_rec.y};
-    RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
-    to_graph(graph_top_left, graph_rec_d, mandelbrot_rec);
+// orbit type the two-phase render keeps for a view, void for mpfr which has no interleaved kernel
+template <typename Rec>
+struct SurvivorOrbit {
+    using type = void;
+};
 
-    Vector2D graph_point = graph_top_left;
+template <typename T>
+struct SurvivorOrbit<RectangleT<T>> {
+    using type = Orbit<T>;
+};
 
-    Vector2D unit;
-    unit.x = mandelbrot_rec.width / graph_rec_d.width; 
-    unit.y = mandelbrot_rec.height / graph_rec_d.height; 
+template <>
+struct SurvivorOrbit<MixedRectangle> {
+    using type = Orbit<double>;
+};
+
+// Float stage of the float-double kernel for one tile row. All lanes step in lockstep without a branch
+// per lane, so the loop vectorizes; lanes past the tile edge are just ignored.
+// e bounds how far the float orbit is from the exact one:
+//   e' <= 2|z_f| e + e^2 + |c - c_f| + rounding of the float step
+// It is kept squared so nothing needs a sqrt, (a + b)^2 <= (1 + 1/16) a^2 + 17 b^2 splits the square.
+// An escape only counts if it holds for every orbit within e of z_f.
+struct FloatStage {
+    float cx[render_tile_size];
+    float cy[render_tile_size];
+    float c_error[render_tile_size];
+    // > 0: escape index, 0: still inside, -1: too close to the bailout to tell
+    int escaped_at[render_tile_size];
+    // z one step past the escape
+    float escape_x[render_tile_size];
+    float escape_y[render_tile_size];
+    // z, dz/dc and e^2 after the last step
+    float zx[render_tile_size];
+    float zy[render_tile_size];
+    float dz_x[render_tile_size];
+    float dz_y[render_tile_size];
+    float error_squared[render_tile_size];
+    // steps actually run, the stage stops early once no lane is open
+    int iterations;
+};
+
+void run_float_stage(FloatStage& lanes) {
+    // one step rounds at most a few times, the bound itself is rounded up generously
+    const float step_rounding = 6.f * std::numeric_limits<float>::epsilon();
+    const float bound_rounding = 1.f + 64.f * std::numeric_limits<float>::epsilon();
+
+    for (int i = 0; i < render_tile_size; ++i) {
+        lanes.escaped_at[i] = 0;
+        lanes.zx[i] = lanes.zy[i] = 0.f;
+        lanes.dz_x[i] = lanes.dz_y[i] = 0.f;
+        lanes.error_squared[i] = 0.f;
+    }
+
+    for (int n = 0; n < float_stage_iterations; ++n) {
+        // most rows are decided long before float_stage_iterations
+        if (n % 8 == 0 && n > 0) {
+            int open = 0;
+            for (int i = 0; i < render_tile_size; ++i) open |= lanes.escaped_at[i] == 0;
+            if (!open) {
+                lanes.iterations = n;
+                return;
+            }
+        }
+        for (int i = 0; i < render_tile_size; ++i) {
+            float x = lanes.zx[i];
+            float y = lanes.zy[i];
+            float e_squared = lanes.error_squared[i];
+            float x_squared = x * x;
+            float y_squared = y * y;
+            float mag = x_squared + y_squared;
+
+            // |z_f| > 2 + e and |z_f| > 2 - e, squared on both sides
+            float above = (mag - 4.f - e_squared) * bound_rounding;
+            float below = (4.f + e_squared - mag) * bound_rounding;
+            // plain arithmetic on the masks, the optimizer turns nested selects back into branches
+            int escaped = (above > 0.f) & (above * above > 16.f * e_squared * bound_rounding);
+            int unclear = (e_squared >= 4.f) | (below < 0.f) | (below * below < 16.f * e_squared * bound_rounding);
+            int open = lanes.escaped_at[i] == 0;
+            int take = open & escaped;
+
+            float next_x = x_squared - y_squared + lanes.cx[i];
+            float next_y = 2.f * x * y + lanes.cy[i];
+
+            lanes.escaped_at[i] += open * (escaped * n - (1 - escaped) * unclear);
+            lanes.escape_x[i] = take ? next_x : lanes.escape_x[i];
+            lanes.escape_y[i] = take ? next_y : lanes.escape_y[i];
+
+            float dz_x = 2.f * (x * lanes.dz_x[i] - y * lanes.dz_y[i]) + 1.f;
+            lanes.dz_y[i] = 2.f * (x * lanes.dz_y[i] + y * lanes.dz_x[i]);
+            lanes.dz_x[i] = dz_x;
+
+            float c_mag = std::abs(lanes.cx[i]) + std::abs(lanes.cy[i]);
+            float small = e_squared + lanes.c_error[i] + step_rounding * (mag + c_mag);
+            lanes.error_squared[i] = (4.25f * mag * e_squared + 17.f * small * small) * bound_rounding;
+            lanes.zx[i] = next_x;
+            lanes.zy[i] = next_y;
+        }
+    }
+    lanes.iterations = float_stage_iterations;
+}
+
+// rows across the real axis from a computed one are copied after the render, see set_mirror_rows
+bool mirrored_row(const Window& window, int y) {
+    return !window.mirror_source.empty() && window.mirror_source[y] >= 0;
+}
+
+// smooth value of an inside pixel, see Window::smooth
+float inside_smooth(const OrbitCycle* cycle) {
+    // the multiplier stays clear of 1, in float period + 0.99999999 would round up to the next period
+    return cycle && cycle->period > 0 ? -(float)(cycle->period + std::min(cycle->multiplier, 0.999)) : 0.f;
+}
+
+// kernel result of one pixel into the buffers and the image, cycle from the kernels with_cycles
+void set_pixel(Window& window, uint64_t pixel, uint64_t n, double mag_squared, uint64_t max_iter, ThreadStats& stats,
+               const OrbitCycle* cycle = nullptr) {
+    float smooth_n = n > 0 ? smooth_iteration(n, mag_squared) : inside_smooth(cycle);
+    window.iterations[pixel] = n;
+    window.smooth[pixel] = smooth_n;
+    if (smooth_n < 0) stats.count_cycle(cycle->iterations);
+    else stats.count(n, max_iter);
+    ImageDrawPixel(&window.graph_image, pixel % window.graph_image.width, pixel / window.graph_image.width,
+                   window.pixel_color_at(pixel, max_iter));
+}
+
+// results of interleaved_in_mandelbrot_set run to budget. Below max_iter the orbits still inside go to
+// survivors and show as inside until phase two is done with them, they are not counted yet.
+template <typename T>
+void set_orbit_results(Window& window, const Orbit<T>* orbits, int count, const uint64_t* iterations, const double* mag_squared,
+                       uint64_t budget, uint64_t max_iter, std::vector<Orbit<T>>* survivors, ThreadStats& stats) {
+    for (int i = 0; i < count; ++i) {
+        const Orbit<T>& orbit = orbits[i];
+        if (iterations[i] == 0 && budget < max_iter) {
+            survivors->push_back(orbit);
+            window.iterations[orbit.pixel] = 0;
+            window.smooth[orbit.pixel] = 0;
+            ImageDrawPixel(&window.graph_image, orbit.pixel % window.graph_image.width, orbit.pixel / window.graph_image.width,
+                           window.pixel_color(0, max_iter));
+            continue;
+        }
+        set_pixel(window, orbit.pixel, iterations[i], mag_squared[i], max_iter, stats);
+    }
+}
+
+// each point is computed from the tile origin, adding up unit in float drifts within a tile.
+// With survivors this is phase one of the two-phase render, only up to phase_one_iterations.
+template <typename T>
+void draw_mandelbrot_image(const RectangleT<T>& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id,
+                           std::vector<Orbit<T>>* survivors = nullptr) {
+
+    const RectangleD& draw_rec = window.tiles[tile_id];
+
+    Vector2T<T> unit;
+    unit.x = mandelbrot_rec.width / (double)window.graph_rec.width; 
+    unit.y = mandelbrot_rec.height / (double)window.graph_rec.height; 
+    double pixels_per_unit = 1.0 / to_double(unit.x);
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    // the interleaved kernel has no dz and no cycle detection, with survivors phase two looks for cycles
+    bool interleaved = window.kernel == KERNEL_INTERLEAVED && !distance_estimation && (window.interior == INTERIOR_OFF || survivors);
+    uint64_t budget = survivors ? std::min(max_iter, phase_one_iterations) : max_iter;
+    bool cycles = window.interior != INTERIOR_OFF;
+    Orbit<T> row_orbits[render_tile_size];
+    uint64_t row_iterations[render_tile_size];
+    double row_mag_squared[render_tile_size];
 
-    
     for (int y = draw_rec.y; y < draw_rec.y + draw_rec.height; ++y) {
-        graph_point.x = graph_top_left.x;
-        for (int x = draw_rec.x; x < draw_rec.x + draw_rec.width; ++x) {
-            uint64_t n = in_mandelbrot_set(graph_point, max_iter);
-            if (n > 0) {
-                if (n >= window.palette.size()) { 
-                    n = window.palette.size() - 1;
-                }
-                ImageDrawPixel(&window.graph_image, x, y, window.palette.at(n));
+        if (mirrored_row(window, y)) continue;
+        Vector2T<T> graph_point;
+        graph_point.y = mandelbrot_rec.y - T(y) * unit.y;
+        if (interleaved) {
+            int width = draw_rec.width;
+            for (int i = 0; i < width; ++i) {
+                int x = draw_rec.x + i;
+                row_orbits[i] = {{mandelbrot_rec.x + T(x) * unit.x, graph_point.y}, {0.0, 0.0}, 0,
+                                 (uint64_t)y * window.graph_image.width + x};
             }
-            graph_point.x += unit.x;
+            interleaved_in_mandelbrot_set(row_orbits, width, budget, row_iterations, row_mag_squared);
+            set_orbit_results(window, row_orbits, width, row_iterations, row_mag_squared, budget, max_iter, survivors, stats);
+            continue;
+        }
+        for (int x = draw_rec.x; x < draw_rec.x + draw_rec.width; ++x) {
+            graph_point.x = mandelbrot_rec.x + T(x) * unit.x;
+
+            double mag_squared;
+            double distance;
+            OrbitCycle cycle;
+            uint64_t n = cycles ? in_mandelbrot_set<T, distance_estimation, true>(graph_point, max_iter, mag_squared, &distance, &cycle)
+                                : in_mandelbrot_set<T, distance_estimation>(graph_point, max_iter, mag_squared, &distance);
+            // every pixel is written, the image is not cleared before a render. distance first, set_pixel shades with it
+            if constexpr (distance_estimation) window.distance[y * window.graph_image.width + x] = n > 0 ? distance * pixels_per_unit : 0;
+            set_pixel(window, (uint64_t)y * window.graph_image.width + x, n, mag_squared, max_iter, stats, &cycle);
         }
-        graph_point.y -= unit.y;
     }
-    graph_point = graph_top_left;
 
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] = stats.seconds;
+    thread_stats[thread_id].add(stats);
 }
 
+// float stage for a row of the tile, then the interleaved double kernel for every pixel it could not decide.
+// A pixel that is still inside goes on in double from z_K if the float error is below what moving c by
+// 2^-scalar_guard_bits pixels would do (|error| <= |dz/dc| * that), the same margin the scalar types get.
+// The rest start over.
+void draw_mandelbrot_image(const MixedRectangle& view, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id,
+                           std::vector<Orbit<double>>* survivors = nullptr) {
+    // the float stage has no dz past the escape and no cycle detection, phase two has
+    if (distance_estimation || (window.interior != INTERIOR_OFF && !survivors)) {
+        draw_mandelbrot_image(view.rec, window, max_iter, tile_id, thread_id);
+        return;
+    }
 
-    // !! Immder die selben draw_recs -> vorberechnen ?
-//void draw_mandelbrot_image_d(const RectangleD& mandelbrot_rec, Window& window, uint64_t max_iter, int thread_id) {
-//
-//    std::unique_lock<std::mutex> lock(mtx);
-//
-//
-//    std::println("thread {} starting first loop", thread_id);
-//
-//    while (threads_running) {
-//
+    const RectangleD& mandelbrot_rec = view.rec;
+    const RectangleD& draw_rec = window.tiles[tile_id];
+    Vector2D unit = {mandelbrot_rec.width / window.graph_rec.width, mandelbrot_rec.height / window.graph_rec.height};
+    double resume_tolerance = std::ldexp(std::max(unit.x, unit.y), -scalar_guard_bits);
+    uint64_t budget = survivors ? std::min(max_iter, phase_one_iterations) : max_iter;
+    int width = draw_rec.width;
+    FloatStage lanes;
+    Orbit<double> row_orbits[render_tile_size];
+    uint64_t row_iterations[render_tile_size];
+    double row_mag_squared[render_tile_size];
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    for (int y = draw_rec.y; y < draw_rec.y + draw_rec.height; ++y) {
+        if (mirrored_row(window, y)) continue;
+        double point_y = mandelbrot_rec.y - y * unit.y;
+        for (int i = 0; i < render_tile_size; ++i) {
+            double point_x = mandelbrot_rec.x + (draw_rec.x + std::min(i, width - 1)) * unit.x;
+            lanes.cx[i] = point_x;
+            lanes.cy[i] = point_y;
+            lanes.c_error[i] = std::abs(point_x - lanes.cx[i]) + std::abs(point_y - lanes.cy[i]);
+        }
+        run_float_stage(lanes);
+
+        int pending = 0;
+        for (int i = 0; i < width; ++i) {
+            int x = draw_rec.x + i;
+            Vector2D point = {mandelbrot_rec.x + x * unit.x, point_y};
+            uint64_t pixel = (uint64_t)y * window.graph_image.width + x;
+
+            int escaped_at = lanes.escaped_at[i];
+            double error_squared = lanes.error_squared[i];
+            double dz_squared = (double)lanes.dz_x[i] * lanes.dz_x[i] + (double)lanes.dz_y[i] * lanes.dz_y[i];
+            if (escaped_at > 0 && (uint64_t)escaped_at < max_iter) {
+                double mag_squared = escape_mag_squared({lanes.escape_x[i], lanes.escape_y[i]}, point, 1);
+                set_pixel(window, pixel, escaped_at, mag_squared, max_iter, stats);
+            } else if (escaped_at == 0 && error_squared <= dz_squared * resume_tolerance * resume_tolerance) {
+                row_orbits[pending++] = {point, {lanes.zx[i], lanes.zy[i]}, (uint64_t)lanes.iterations, pixel};
+            } else {
+                row_orbits[pending++] = {point, {0.0, 0.0}, 0, pixel};
+            }
+        }
+        interleaved_in_mandelbrot_set(row_orbits, pending, budget, row_iterations, row_mag_squared);
+        set_orbit_results(window, row_orbits, pending, row_iterations, row_mag_squared, budget, max_iter, survivors, stats);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] = stats.seconds;
+    thread_stats[thread_id].add(stats);
+}
+
+// phase two of the two-phase render, survivors[begin, end) from where phase one left them to max_iter.
+// The list is dense, so the lanes stay full instead of idling next to pixels that escaped long ago.
+// With interior detection the survivors are mostly inside, one at a time with cycle detection pays more.
+template <typename T>
+void draw_survivors(std::vector<Orbit<T>>& survivors, uint64_t begin, uint64_t end, Window& window, uint64_t max_iter, uint64_t thread_id) {
+    uint64_t iterations[survivor_chunk];
+    double mag_squared[survivor_chunk];
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    int count = end - begin;
+    if (window.interior != INTERIOR_OFF) {
+        for (int i = 0; i < count; ++i) {
+            Orbit<T>& orbit = survivors[begin + i];
+            Vector2D dz = {0};
+            OrbitCycle cycle;
+            uint64_t n = iterate_orbit<T, false, true>(orbit.c, orbit.z, dz, orbit.n, max_iter, &cycle);
+            double mag = n > 0 ? escape_mag_squared(to_double(orbit.z), to_double(orbit.c), 1) : 0;
+            set_pixel(window, orbit.pixel, n, mag, max_iter, stats, &cycle);
+        }
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        thread_stats[thread_id].add(stats);
+        return;
+    }
+
+    interleaved_in_mandelbrot_set(&survivors[begin], count, max_iter, iterations, mag_squared);
+    for (int i = 0; i < count; ++i) {
+        set_pixel(window, survivors[begin + i].pixel, iterations[i], mag_squared[i], max_iter, stats);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    thread_stats[thread_id].add(stats);
+}
+
+void draw_mandelbrot_image(const RectangleAP& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id) {
+
+    MandelbrotVectors& mandelbrot_vectors = thread_mandelbrot_vectors[thread_id];
+    DrawVectors& draw_vectors = thread_draw_vectors[thread_id];
+
+    const RectangleD& draw_rec = window.tiles[tile_id];
+    RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
+
+    Vector2AP& graph_top_left = draw_vectors.top_left;
+    mpfr_set_d(graph_top_left.x, draw_rec.x, MPFR_RNDN);
+    mpfr_set_d(graph_top_left.y, draw_rec.y, MPFR_RNDN);
+    to_graph(graph_top_left, graph_rec_d, mandelbrot_rec);
+
+    Vector2AP& graph_point = draw_vectors.graph_point;
+    mpfr_set(graph_point.y, graph_top_left.y, MPFR_RNDN);
+
+    Vector2AP& unit = draw_vectors.unit;
+    mpfr_div_d(unit.x, mandelbrot_rec.width, graph_rec_d.width, MPFR_RNDN);
+    mpfr_div_d(unit.y, mandelbrot_rec.height, graph_rec_d.height, MPFR_RNDN);
+    double pixels_per_unit = graph_rec_d.width / mpfr_get_d(mandelbrot_rec.width, MPFR_RNDN);
+    bool cycles = window.interior != INTERIOR_OFF;
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    for (int y = draw_rec.y; y < draw_rec.y + draw_rec.height; ++y) {
+        if (mirrored_row(window, y)) continue;
+        mpfr_set(graph_point.x, graph_top_left.x, MPFR_RNDN);
+        for (int x = draw_rec.x; x < draw_rec.x + draw_rec.width; ++x) {
+            double mag_squared;
+            double distance;
+            OrbitCycle cycle;
+            uint64_t n = cycles ? in_mandelbrot_set<distance_estimation, true>(graph_point, mandelbrot_vectors, max_iter, mag_squared, &distance, &cycle)
+                                : in_mandelbrot_set<distance_estimation>(graph_point, mandelbrot_vectors, max_iter, mag_squared, &distance);
+            // every pixel is written, the image is not cleared before a render. distance first, set_pixel shades with it
+            if constexpr (distance_estimation) window.distance[y * window.graph_image.width + x] = n > 0 ? distance * pixels_per_unit : 0;
+            set_pixel(window, (uint64_t)y * window.graph_image.width + x, n, mag_squared, max_iter, stats, &cycle);
+            mpfr_add(graph_point.x, graph_point.x, unit.x, MPFR_RNDN);
+        }
+        mpfr_sub(graph_point.y, graph_point.y, unit.y, MPFR_RNDN);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] = stats.seconds;
+    thread_stats[thread_id].add(stats);
+}
+
+// sets the pixels of [x0, x1] x [y0, y1] to inside without computing them, returns how many
+uint64_t fill_inside(Window& window, int x0, int y0, int x1, int y1, uint64_t max_iter) {
+    uint64_t width = window.graph_image.width;
+    Color color = window.pixel_color(0, max_iter);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            uint64_t pixel = (uint64_t)y * width + x;
+            window.iterations[pixel] = 0;
+            window.smooth[pixel] = 0;
+            if constexpr (distance_estimation) window.distance[pixel] = 0;
+            ImageDrawPixel(&window.graph_image, x, y, color);
+        }
+    }
+    return (uint64_t)(x1 - x0 + 1) * (y1 - y0 + 1);
+}
+
+// Solid guessing. The tile starts as cells of guess_step pixels. A cell whose border and middle row and
+// column are all inside gets the rest filled without computing it, any other cell is split in four down
+// to single pixels. This is a heuristic, not exact: the escaping points connect to the outside, but the
+// channel can be thinner than a pixel and pass between two samples. The full render shows such a channel
+// as lone escaped pixels, and guessing then fills some of them as inside, from a few to a few dozen
+// per megapixel in the views tried. Use --strategy certify where that matters.
+// Cells share their borders, known keeps every border pixel computed once. compute_pixels(pixels, count, stats)
+// runs the kernel for a list of pixel indices and writes them like the draw functions do.
+constexpr int guess_step = 16;
+
+template <typename Compute>
+void guess_tile(Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id, Compute&& compute_pixels) {
+    struct Cell {
+        // corners, inclusive
+        int x0, y0, x1, y1;
+    };
+
+    const RectangleD& draw_rec = window.tiles[tile_id];
+    uint64_t width = window.graph_image.width;
+    int left = draw_rec.x;
+    int right = draw_rec.x + draw_rec.width - 1;
+    // mirroring only takes rows off one side, the computed rows of a tile are one range
+    int top = draw_rec.y;
+    int bottom = draw_rec.y + draw_rec.height - 1;
+    while (mirrored_row(window, top)) ++top;
+    while (mirrored_row(window, bottom)) --bottom;
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    bool known[render_tile_size * render_tile_size] = {};
+    auto is_known = [&](int x, int y) -> bool& {
+        return known[(y - (int)draw_rec.y) * render_tile_size + x - (int)draw_rec.x];
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Cell> next_cells;
+    std::vector<uint64_t> pending;
+    for (int y0 = top;; y0 += guess_step) {
+        int y1 = std::min(y0 + guess_step, bottom);
+        for (int x0 = left;; x0 += guess_step) {
+            int x1 = std::min(x0 + guess_step, right);
+            cells.push_back({x0, y0, x1, y1});
+            if (x1 == right) break;
+        }
+        if (y1 == bottom) break;
+    }
+
+    auto for_border = [](const Cell& cell, auto&& f) {
+        for (int x = cell.x0; x <= cell.x1; ++x) {
+            f(x, cell.y0);
+            if (cell.y1 != cell.y0) f(x, cell.y1);
+        }
+        for (int y = cell.y0 + 1; y < cell.y1; ++y) {
+            f(cell.x0, y);
+            if (cell.x1 != cell.x0) f(cell.x1, y);
+        }
+    };
+
+    while (!cells.empty()) {
+        pending.clear();
+        for (const Cell& cell : cells) {
+            for_border(cell, [&](int x, int y) {
+                if (is_known(x, y)) return;
+                is_known(x, y) = true;
+                pending.push_back((uint64_t)y * width + x);
+            });
+        }
+        compute_pixels(pending.data(), (int)pending.size(), stats);
+
+        // cells with an inside border also get their middle row and column, the borders of the
+        // four quarters, so a split after all does not compute anything twice
+        auto all_inside = [&](const Cell& cell) {
+            bool inside = true;
+            for_border(cell, [&](int x, int y) {
+                inside = inside && window.iterations[(uint64_t)y * width + x] == 0;
+            });
+            return inside;
+        };
+        auto for_cross = [](const Cell& cell, auto&& f) {
+            int mid_x = (cell.x0 + cell.x1) / 2;
+            int mid_y = (cell.y0 + cell.y1) / 2;
+            for (int x = cell.x0 + 1; x < cell.x1; ++x) f(x, mid_y);
+            for (int y = cell.y0 + 1; y < cell.y1; ++y) {
+                if (y != mid_y) f(mid_x, y);
+            }
+        };
+
+        next_cells.clear();
+        pending.clear();
+        std::erase_if(cells, [](const Cell& cell) {
+            // nothing between the borders
+            return cell.x1 - cell.x0 < 2 || cell.y1 - cell.y0 < 2;
+        });
+        for (const Cell& cell : cells) {
+            if (!all_inside(cell)) continue;
+            for_cross(cell, [&](int x, int y) {
+                if (is_known(x, y)) return;
+                is_known(x, y) = true;
+                pending.push_back((uint64_t)y * width + x);
+            });
+        }
+        compute_pixels(pending.data(), (int)pending.size(), stats);
+
+        for (const Cell& cell : cells) {
+            bool inside = all_inside(cell);
+            for_cross(cell, [&](int x, int y) {
+                inside = inside && window.iterations[(uint64_t)y * width + x] == 0;
+            });
+            int mid_x = (cell.x0 + cell.x1) / 2;
+            int mid_y = (cell.y0 + cell.y1) / 2;
+            if (inside) {
+                // the quarters without the computed cross
+                for (auto [x0, x1] : {std::pair(cell.x0 + 1, mid_x - 1), std::pair(mid_x + 1, cell.x1 - 1)}) {
+                    for (auto [y0, y1] : {std::pair(cell.y0 + 1, mid_y - 1), std::pair(mid_y + 1, cell.y1 - 1)}) {
+                        if (x0 <= x1 && y0 <= y1) stats.guessed_pixels += fill_inside(window, x0, y0, x1, y1, max_iter);
+                    }
+                }
+                continue;
+            }
+
+            next_cells.push_back({cell.x0, cell.y0, mid_x, mid_y});
+            next_cells.push_back({mid_x, cell.y0, cell.x1, mid_y});
+            next_cells.push_back({cell.x0, mid_y, mid_x, cell.y1});
+            next_cells.push_back({mid_x, mid_y, cell.x1, cell.y1});
+        }
+        cells.swap(next_cells);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] = stats.seconds;
+    thread_stats[thread_id].add(stats);
+}
+
+// closed interval of doubles. Every operation rounds to nearest and then widens both ends, so the result
+// always contains the exact one.
+struct Interval {
+    double lo;
+    double hi;
+};
+
+// a rounded r is at most half an ulp off and |r| * 2^-52 is at least one ulp, the smallest subnormal
+// covers r = 0. Cheaper than std::nextafter and no branch
+inline Interval widen(double lo, double hi) {
+    constexpr double tiny = std::numeric_limits<double>::denorm_min();
+    return {lo - (std::abs(lo) * 0x1p-52 + tiny), hi + (std::abs(hi) * 0x1p-52 + tiny)};
+}
+
+inline Interval operator+(const Interval& a, const Interval& b) {
+    return widen(a.lo + b.lo, a.hi + b.hi);
+}
+
+inline Interval operator-(const Interval& a, const Interval& b) {
+    return widen(a.lo - b.hi, a.hi - b.lo);
+}
+
+inline Interval operator*(const Interval& a, const Interval& b) {
+    double p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+    return widen(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+}
+
+// x * x is tighter than x times itself, both factors are the same point
+inline Interval square(const Interval& a) {
+    if (a.lo >= 0) return widen(a.lo * a.lo, a.hi * a.hi);
+    if (a.hi <= 0) return widen(a.hi * a.hi, a.lo * a.lo);
+    return {0, widen(0, std::max(a.lo * a.lo, a.hi * a.hi)).hi};
+}
+
+inline bool contains(const Interval& outer, const Interval& inner) {
+    return outer.lo <= inner.lo && inner.hi <= outer.hi;
+}
+
+// c of a block of pixels, enclosing every c the kernel computes for them
+struct IntervalBox {
+    Interval x;
+    Interval y;
+};
+
+// nearest double and an ulp outwards, for bounds held in a wider type
+template <typename T>
+double lower_double(const T& value) {
+    return std::nextafter(to_double(value), -INFINITY);
+}
+
+template <typename T>
+double upper_double(const T& value) {
+    return std::nextafter(to_double(value), INFINITY);
+}
+
+constexpr int certify_min_block = 8;
+constexpr uint64_t certify_iterations = 512;
+
+// true if every c in the box has a bounded orbit, so the box is inside no matter what max_iter is.
+// First the period 2 bulb and the main cardioid in closed form, then the whole box is iterated as an
+// interval: once Z_j fits into an earlier Z_k, every later box fits into one before it (the interval
+// step only grows with its input), so no orbit ever leaves Z_k. That is the attracting cycle, found with
+// Brent's power of two checkpoints so any period works. Boxes that reach radius 2 give up, and so does
+// a box that is not trapped after what a pixel would iterate.
+bool certified_inside(const IntervalBox& c, uint64_t max_iter) {
+    Interval y_squared = square(c.y);
+    if ((square(c.x + Interval{1, 1}) + y_squared).hi < 0.0625) return true;
+
+    // q (q + x - 1/4) < y^2 / 4 with q = (x - 1/4)^2 + y^2
+    Interval x = c.x - Interval{0.25, 0.25};
+    Interval q = square(x) + y_squared;
+    if ((q * (q + x)).hi < y_squared.lo * 0.25) return true;
+
+    Interval zx = {0, 0};
+    Interval zy = {0, 0};
+    IntervalBox trap = {zx, zy};
+    uint64_t trap_at = 1;
+    uint64_t budget = std::min(certify_iterations, max_iter);
+    for (uint64_t i = 1; i <= budget; ++i) {
+        Interval x_squared = square(zx);
+        Interval z_y_squared = square(zy);
+        if (x_squared.hi + z_y_squared.hi > 4) return false;
+
+        Interval xy = zx * zy;
+        zy = Interval{2 * xy.lo, 2 * xy.hi} + c.y;
+        zx = x_squared - z_y_squared + c.x;
+        if (contains(trap.x, zx) && contains(trap.y, zy)) return true;
+
+        if (i == trap_at) {
+            trap = {zx, zy};
+            trap_at *= 2;
+        }
+    }
+    return false;
+}
+
+// Certified render of a tile: blocks from the whole tile down to certify_min_block pixels that
+// certified_inside proves inside are filled, the other pixels go through compute_pixels like in
+// guess_tile. bounds(x0, y0, x1, y1) is the IntervalBox of the pixel block. Only inside is certified,
+// a box that escapes at one n still needs |z_n| per pixel for the smooth coloring, and that only
+// happens a few iterations in where pixels are cheap anyway. Tiles with nothing certified go to
+// draw_tile, the usual row kernel.
+template <typename Bounds, typename Compute, typename Draw>
+void certify_tile(Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id, Bounds&& bounds, Compute&& compute_pixels, Draw&& draw_tile) {
+    struct Block {
+        int x0, y0, x1, y1;
+    };
+
+    const RectangleD& draw_rec = window.tiles[tile_id];
+    uint64_t width = window.graph_image.width;
+    int left = draw_rec.x;
+    int right = draw_rec.x + draw_rec.width - 1;
+    int top = draw_rec.y;
+    int bottom = draw_rec.y + draw_rec.height - 1;
+    while (mirrored_row(window, top)) ++top;
+    while (mirrored_row(window, bottom)) --bottom;
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    bool certified[render_tile_size * render_tile_size] = {};
+    std::vector<Block> blocks = {{left, top, right, bottom}};
+    while (!blocks.empty()) {
+        Block block = blocks.back();
+        blocks.pop_back();
+        if (certified_inside(bounds(block.x0, block.y0, block.x1, block.y1), max_iter)) {
+            stats.guessed_pixels += fill_inside(window, block.x0, block.y0, block.x1, block.y1, max_iter);
+            for (int y = block.y0; y <= block.y1; ++y) {
+                std::fill_n(&certified[(y - top) * render_tile_size + block.x0 - left], block.x1 - block.x0 + 1, true);
+            }
+            continue;
+        }
+        if (block.x1 - block.x0 + 1 < 2 * certify_min_block && block.y1 - block.y0 + 1 < 2 * certify_min_block) continue;
+
+        int mid_x = (block.x0 + block.x1) / 2;
+        int mid_y = (block.y0 + block.y1) / 2;
+        blocks.push_back({block.x0, block.y0, mid_x, mid_y});
+        if (mid_x < block.x1) blocks.push_back({mid_x + 1, block.y0, block.x1, mid_y});
+        if (mid_y < block.y1) blocks.push_back({block.x0, mid_y + 1, mid_x, block.y1});
+        if (mid_x < block.x1 && mid_y < block.y1) blocks.push_back({mid_x + 1, mid_y + 1, block.x1, block.y1});
+    }
+
+    if (stats.guessed_pixels == 0) {
+        draw_tile();
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - window.tile_seconds[tile_id];
+        window.tile_seconds[tile_id] += stats.seconds;
+        thread_stats[thread_id].add(stats);
+        return;
+    }
+
+    std::vector<uint64_t> pending;
+    for (int y = top; y <= bottom; ++y) {
+        for (int x = left; x <= right; ++x) {
+            if (!certified[(y - top) * render_tile_size + x - left]) pending.push_back((uint64_t)y * width + x);
+        }
+    }
+    compute_pixels(pending.data(), (int)pending.size(), stats);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] = stats.seconds;
+    thread_stats[thread_id].add(stats);
+}
+
+// compute_pixels for guess_tile and certify_tile. The pixel lists go through the interleaved kernel in
+// row sized batches, to max_iter since the strategies need the final answer.
+template <typename T>
+auto pixel_kernel(const RectangleT<T>& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t /* thread_id, for the mpfr overload */) {
+    Vector2T<T> unit;
+    unit.x = mandelbrot_rec.width / (double)window.graph_rec.width;
+    unit.y = mandelbrot_rec.height / (double)window.graph_rec.height;
+    double pixels_per_unit = 1.0 / to_double(unit.x);
+    uint64_t width = window.graph_image.width;
+    bool interleaved = window.kernel == KERNEL_INTERLEAVED && !distance_estimation && window.interior == INTERIOR_OFF;
+    bool cycles = window.interior != INTERIOR_OFF;
+
+    return [=, &window](const uint64_t* pixels, int count, ThreadStats& stats) {
+        auto point = [&](uint64_t pixel) {
+            return Vector2T<T>{mandelbrot_rec.x + T(pixel % width) * unit.x, mandelbrot_rec.y - T(pixel / width) * unit.y};
+        };
+
+        if (interleaved) {
+            Orbit<T> orbits[render_tile_size];
+            uint64_t iterations[render_tile_size];
+            double mag_squared[render_tile_size];
+            for (int begin = 0; begin < count; begin += render_tile_size) {
+                int batch = std::min(render_tile_size, count - begin);
+                for (int i = 0; i < batch; ++i) {
+                    orbits[i] = {point(pixels[begin + i]), {0.0, 0.0}, 0, pixels[begin + i]};
+                }
+                interleaved_in_mandelbrot_set(orbits, batch, max_iter, iterations, mag_squared);
+                set_orbit_results(window, orbits, batch, iterations, mag_squared, max_iter, max_iter, (std::vector<Orbit<T>>*)nullptr, stats);
+            }
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            double mag_squared;
+            double distance;
+            OrbitCycle cycle;
+            uint64_t n = cycles ? in_mandelbrot_set<T, distance_estimation, true>(point(pixels[i]), max_iter, mag_squared, &distance, &cycle)
+                                : in_mandelbrot_set<T, distance_estimation>(point(pixels[i]), max_iter, mag_squared, &distance);
+            if constexpr (distance_estimation) window.distance[pixels[i]] = n > 0 ? distance * pixels_per_unit : 0;
+            set_pixel(window, pixels[i], n, mag_squared, max_iter, stats, &cycle);
+        }
+    };
+}
+
+// the pixel lists are scattered, the float stage wants whole rows, so plain double here
+auto pixel_kernel(const MixedRectangle& view, Window& window, uint64_t max_iter, uint64_t thread_id) {
+    return pixel_kernel(view.rec, window, max_iter, thread_id);
+}
+
+auto pixel_kernel(const RectangleAP& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t thread_id) {
+    MandelbrotVectors& mandelbrot_vectors = thread_mandelbrot_vectors[thread_id];
+    DrawVectors& draw_vectors = thread_draw_vectors[thread_id];
+    double pixels_per_unit = window.graph_rec.width / mpfr_get_d(mandelbrot_rec.width, MPFR_RNDN);
+    uint64_t width = window.graph_image.width;
+    bool cycles = window.interior != INTERIOR_OFF;
+
+    return [=, &mandelbrot_rec, &window, &mandelbrot_vectors, &draw_vectors](const uint64_t* pixels, int count, ThreadStats& stats) {
+        Vector2AP& unit = draw_vectors.unit;
+        mpfr_div_d(unit.x, mandelbrot_rec.width, window.graph_rec.width, MPFR_RNDN);
+        mpfr_div_d(unit.y, mandelbrot_rec.height, window.graph_rec.height, MPFR_RNDN);
+        Vector2AP& graph_point = draw_vectors.graph_point;
+
+        for (int i = 0; i < count; ++i) {
+            mpfr_mul_d(graph_point.x, unit.x, pixels[i] % width, MPFR_RNDN);
+            mpfr_add(graph_point.x, graph_point.x, mandelbrot_rec.x, MPFR_RNDN);
+            mpfr_mul_d(graph_point.y, unit.y, pixels[i] / width, MPFR_RNDN);
+            mpfr_sub(graph_point.y, mandelbrot_rec.y, graph_point.y, MPFR_RNDN);
+
+            double mag_squared;
+            double distance;
+            OrbitCycle cycle;
+            uint64_t n = cycles ? in_mandelbrot_set<distance_estimation, true>(graph_point, mandelbrot_vectors, max_iter, mag_squared, &distance, &cycle)
+                                : in_mandelbrot_set<distance_estimation>(graph_point, mandelbrot_vectors, max_iter, mag_squared, &distance);
+            if constexpr (distance_estimation) window.distance[pixels[i]] = n > 0 ? distance * pixels_per_unit : 0;
+            set_pixel(window, pixels[i], n, mag_squared, max_iter, stats, &cycle);
+        }
+    };
+}
+
+// bounds for certify_tile. The corners are computed like the kernels compute c, rounding keeps the order,
+// so the corner values enclose every pixel of the block. Then outwards to double.
+template <typename T>
+auto pixel_bounds(const RectangleT<T>& mandelbrot_rec, const Window& window, uint64_t /* thread_id, for the mpfr overload */) {
+    Vector2T<T> unit;
+    unit.x = mandelbrot_rec.width / (double)window.graph_rec.width;
+    unit.y = mandelbrot_rec.height / (double)window.graph_rec.height;
+
+    return [=](int x0, int y0, int x1, int y1) {
+        return IntervalBox{{lower_double(mandelbrot_rec.x + T(x0) * unit.x), upper_double(mandelbrot_rec.x + T(x1) * unit.x)},
+                           {lower_double(mandelbrot_rec.y - T(y1) * unit.y), upper_double(mandelbrot_rec.y - T(y0) * unit.y)}};
+    };
+}
+
+auto pixel_bounds(const MixedRectangle& view, const Window& window, uint64_t thread_id) {
+    return pixel_bounds(view.rec, window, thread_id);
+}
+
+// same steps as pixel_kernel, mpfr_get_d rounds outwards by itself
+auto pixel_bounds(const RectangleAP& mandelbrot_rec, const Window& window, uint64_t thread_id) {
+    DrawVectors& draw_vectors = thread_draw_vectors[thread_id];
+
+    return [&mandelbrot_rec, &window, &draw_vectors](int x0, int y0, int x1, int y1) {
+        Vector2AP& unit = draw_vectors.unit;
+        mpfr_div_d(unit.x, mandelbrot_rec.width, window.graph_rec.width, MPFR_RNDN);
+        mpfr_div_d(unit.y, mandelbrot_rec.height, window.graph_rec.height, MPFR_RNDN);
+        Vector2AP& corner = draw_vectors.graph_point;
+
+        IntervalBox box;
+        mpfr_mul_d(corner.x, unit.x, x0, MPFR_RNDN);
+        mpfr_add(corner.x, corner.x, mandelbrot_rec.x, MPFR_RNDN);
+        box.x.lo = mpfr_get_d(corner.x, MPFR_RNDD);
+        mpfr_mul_d(corner.x, unit.x, x1, MPFR_RNDN);
+        mpfr_add(corner.x, corner.x, mandelbrot_rec.x, MPFR_RNDN);
+        box.x.hi = mpfr_get_d(corner.x, MPFR_RNDU);
+        mpfr_mul_d(corner.y, unit.y, y1, MPFR_RNDN);
+        mpfr_sub(corner.y, mandelbrot_rec.y, corner.y, MPFR_RNDN);
+        box.y.lo = mpfr_get_d(corner.y, MPFR_RNDD);
+        mpfr_mul_d(corner.y, unit.y, y0, MPFR_RNDN);
+        mpfr_sub(corner.y, mandelbrot_rec.y, corner.y, MPFR_RNDN);
+        box.y.hi = mpfr_get_d(corner.y, MPFR_RNDU);
+        return box;
+    };
+}
+
+// one tile with window.strategy, guess or certify
+template <typename Rec>
+void strategy_tile(const Rec& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id) {
+    auto compute_pixels = pixel_kernel(mandelbrot_rec, window, max_iter, thread_id);
+    if (window.strategy == STRATEGY_GUESS) {
+        guess_tile(window, max_iter, tile_id, thread_id, compute_pixels);
+        return;
+    }
+    certify_tile(window, max_iter, tile_id, thread_id, pixel_bounds(mandelbrot_rec, window, thread_id), compute_pixels, [&] {
+        draw_mandelbrot_image(mandelbrot_rec, window, max_iter, tile_id, thread_id);
+    });
+}
+
+// splits the graph into render_tile_size tiles, row major
+void set_tiles(Window& window) {
+    window.tiles.clear();
+
+    int width = window.graph_rec.width;
+    int height = window.graph_rec.height;
+    for (int y = 0; y < height; y += render_tile_size) {
+        for (int x = 0; x < width; x += render_tile_size) {
+            window.tiles.push_back({(double)x, (double)y, (double)std::min(render_tile_size, width - x), (double)std::min(render_tile_size, height - y)});
+        }
+    }
+    window.tile_seconds.assign(window.tiles.size(), 0.0);
+}
+
+// c and conj(c) have conjugate orbits, so rows at the same distance above and below the real axis are
+// mirror images. The axis has to sit on a row or halfway between two, up to 2^-scalar_guard_bits of a
+// pixel like everywhere else. The side with more rows is computed, the other one copies what it can.
+void set_mirror_rows(Window& window, const Mandelbrot& mandelbrot, ComputeMode compute_mode) {
+    int height = window.graph_rec.height;
+    window.mirror_source.clear();
+
+    // row of the real axis, c.y = top - row * height / graph height
+    double axis;
+    if (compute_mode == MPFR) {
+        const RectangleAP& rec = mandelbrot.mandelbrot_rec_mpfr;
+        mpfr_t ratio;
+        mpfr_init2(ratio, mpfr_get_prec(rec.y));
+        mpfr_div(ratio, rec.y, rec.height, MPFR_RNDN);
+        axis = mpfr_get_d(ratio, MPFR_RNDN) * height;
+        mpfr_clear(ratio);
+    } else {
+        axis = mandelbrot.mandelbrot_rec_d.y / mandelbrot.mandelbrot_rec_d.height * height;
+    }
+    if (!(axis > 0 && axis < height)) return;
+
+    double twice_axis = std::round(2 * axis);
+    if (std::abs(2 * axis - twice_axis) > std::ldexp(1.0, -scalar_guard_bits)) return;
+
+    int mirror = twice_axis;
+    bool upper_computed = axis >= height - axis;
+    window.mirror_source.assign(height, -1);
+    for (int y = 0; y < height; ++y) {
+        int other = mirror - y;
+        if (other < 0 || other >= height || other == y) continue;
+        if (upper_computed ? y > other : y < other) window.mirror_source[y] = other;
+    }
+}
+
+// copies the mirrored rows from their sources, image_only after the antialiasing pass which only changes
+// colors. Returns the tiles that got rows.
+std::vector<uint64_t> mirror_rows(Window& window, bool image_only) {
+    std::vector<uint64_t> mirrored_tiles;
+    if (window.mirror_source.empty()) return mirrored_tiles;
+
+    uint64_t width = window.graph_image.width;
+    Color* pixels = (Color*)window.graph_image.data;
+    window.mirrored_pixels = 0;
+    for (int y = 0; y < (int)window.mirror_source.size(); ++y) {
+        int source = window.mirror_source[y];
+        if (source < 0) continue;
+
+        std::memcpy(&pixels[y * width], &pixels[source * width], width * sizeof(Color));
+        window.mirrored_pixels += width;
+        if (image_only) continue;
+        std::copy_n(&window.iterations[source * width], width, &window.iterations[y * width]);
+        std::copy_n(&window.smooth[source * width], width, &window.smooth[y * width]);
+        if constexpr (distance_estimation) std::copy_n(&window.distance[source * width], width, &window.distance[y * width]);
+    }
+
+    for (uint64_t tile_id = 0; tile_id < window.tiles.size(); ++tile_id) {
+        const RectangleD& tile = window.tiles[tile_id];
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            if (!mirrored_row(window, y)) continue;
+            mirrored_tiles.push_back(tile_id);
+            break;
+        }
+    }
+    return mirrored_tiles;
+}
+
+// optional timestamps of a render_mandelbrot call
+struct RenderTimes {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point first_tile;
+    std::chrono::steady_clock::time_point done;
+    std::once_flag first_tile_flag;
+};
+
+// counts window.smooth into the histogram bins and recolors graph_image with the new cdf.
+// Every thread owns a row range for counting and recoloring and a bin range for merging and the
+// prefix sum, the phases are separated by a barrier so nothing needs a lock.
+void apply_histogram(Window& window, uint64_t max_iter, uint64_t num_threads) {
+    TRACE_ZONE("histogram");
+    num_threads = std::max<uint64_t>(1, num_threads);
+    uint64_t width = window.graph_image.width;
+    uint64_t height = window.graph_image.height;
+
+    std::vector<std::vector<uint64_t>> thread_counts(num_threads, std::vector<uint64_t>(histogram_bins));
+    std::vector<uint64_t> counts(histogram_bins);
+    std::vector<uint64_t> range_sums(num_threads);
+    window.histogram_cdf.resize(histogram_bins + 1);
+    std::barrier phase(num_threads);
+
+    auto work = [&](uint64_t i) {
+        uint64_t row_begin = height * i / num_threads;
+        uint64_t row_end = height * (i + 1) / num_threads;
+        uint64_t bin_begin = histogram_bins * i / num_threads;
+        uint64_t bin_end = histogram_bins * (i + 1) / num_threads;
+
+        std::vector<uint64_t>& own = thread_counts[i];
+        for (uint64_t index = row_begin * width; index < row_end * width; ++index) {
+            float smooth_n = window.smooth[index];
+            if (smooth_n <= 0) continue;
+            float position;
+            ++own[histogram_bin(smooth_n, max_iter, position)];
+        }
+        phase.arrive_and_wait();
+
+        uint64_t range_sum = 0;
+        for (uint64_t bin = bin_begin; bin < bin_end; ++bin) {
+            uint64_t count = 0;
+            for (const std::vector<uint64_t>& other : thread_counts) count += other[bin];
+            counts[bin] = count;
+            range_sum += count;
+        }
+        range_sums[i] = range_sum;
+        phase.arrive_and_wait();
+
+        uint64_t below = 0;
+        uint64_t escaped = 0;
+        for (uint64_t j = 0; j < num_threads; ++j) {
+            if (j < i) below += range_sums[j];
+            escaped += range_sums[j];
+        }
+        for (uint64_t bin = bin_begin; bin < bin_end; ++bin) {
+            window.histogram_cdf[bin] = escaped > 0 ? (double)below / escaped : 0.f;
+            below += counts[bin];
+        }
+        if (i == num_threads - 1) window.histogram_cdf[histogram_bins] = escaped > 0 ? 1.f : 0.f;
+        phase.arrive_and_wait();
+
+        Color* pixels = (Color*)window.graph_image.data;
+        for (uint64_t index = row_begin * width; index < row_end * width; ++index) {
+            pixels[index] = window.pixel_color_at(index, max_iter);
+        }
+    };
+
+    std::vector<std::jthread> histogram_workers;
+    for (uint64_t i = 1; i < num_threads; ++i) {
+        histogram_workers.emplace_back(work, i);
+    }
+    work(0);
+}
+
+// same hash for the same pixel, so antialiased renders are reproducible
+float sample_jitter(uint64_t x, uint64_t y, uint64_t k) {
+    uint64_t h = x * 0x9e3779b97f4a7c15ull ^ y * 0xc2b2ae3d27d4eb4full ^ k * 0x165667b19e3779f9ull;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 29;
+    return (h >> 40) / (float)(1 << 24);
+}
+
+bool aa_edge(const Window& window, int x, int y, uint64_t max_iter) {
+    int width = window.graph_image.width;
+    int height = window.graph_image.height;
+    // colors from smooth, graph_image of the neighbour tiles may be rewritten right now
+    Color color = window.pixel_color(window.smooth[(uint64_t)y * width + x], max_iter);
+
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& offset : offsets) {
+        int nx = x + offset[0];
+        int ny = y + offset[1];
+        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+        Color other = window.pixel_color(window.smooth[(uint64_t)ny * width + nx], max_iter);
+        if (std::abs(color.r - other.r) > aa_threshold || std::abs(color.g - other.g) > aa_threshold ||
+            std::abs(color.b - other.b) > aa_threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// second pass over a finished tile, replaces edge pixels by the mean of window.aa_grid^2 jittered samples.
+// sample(x, y) returns the smooth iteration count at the pixel coordinate (x, y).
+template <typename Sample>
+void antialias_tile(Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id, Sample&& sample) {
+    const RectangleD& draw_rec = window.tiles[tile_id];
+    int grid = window.aa_grid;
+
+    ThreadStats stats = {};
+    auto start = std::chrono::steady_clock::now();
+
+    for (int y = draw_rec.y; y < draw_rec.y + draw_rec.height; ++y) {
+        if (mirrored_row(window, y)) continue;
+        for (int x = draw_rec.x; x < draw_rec.x + draw_rec.width; ++x) {
+            if (!aa_edge(window, x, y, max_iter)) continue;
+            ++stats.aa_pixels;
+
+            uint64_t r = 0, g = 0, b = 0;
+            for (int k = 0; k < grid * grid; ++k) {
+                // one sample per grid cell, jittered inside the cell, pixel (x, y) spans x +- 0.5
+                double sample_x = x - 0.5 + (k % grid + sample_jitter(x, y, 2 * k)) / grid;
+                double sample_y = y - 0.5 + (k / grid + sample_jitter(x, y, 2 * k + 1)) / grid;
+                Color color = window.pixel_color(sample(sample_x, sample_y, stats), max_iter);
+                r += color.r;
+                g += color.g;
+                b += color.b;
+            }
+            uint64_t count = grid * grid;
+            // the samples carry no distance, the shading of the pixel center keeps the boundary dark
+            Color color = {(unsigned char)(r / count), (unsigned char)(g / count), (unsigned char)(b / count), 255};
+            ImageDrawPixel(&window.graph_image, x, y, window.shade_boundary(color, (uint64_t)y * window.graph_image.width + x));
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    window.tile_seconds[tile_id] += stats.seconds;
+    thread_stats[thread_id].add(stats);
+}
+
+template <typename T>
+void antialias_tile(const RectangleT<T>& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id) {
+    Vector2T<T> unit = {T(mandelbrot_rec.width / (double)window.graph_rec.width), T(mandelbrot_rec.height / (double)window.graph_rec.height)};
+
+    bool cycles = window.interior != INTERIOR_OFF;
+
+    antialias_tile(window, max_iter, tile_id, thread_id, [&](double x, double y, ThreadStats& stats) {
+        Vector2T<T> point = {mandelbrot_rec.x + T(x) * unit.x, mandelbrot_rec.y - T(y) * unit.y};
+        double mag_squared;
+        OrbitCycle cycle;
+        uint64_t n = cycles ? in_mandelbrot_set<T, false, true>(point, max_iter, mag_squared, nullptr, &cycle)
+                            : in_mandelbrot_set(point, max_iter, mag_squared);
+        stats.iterations += n > 0 ? n : cycle.period > 0 ? cycle.iterations : max_iter;
+        return n > 0 ? smooth_iteration(n, mag_squared) : inside_smooth(&cycle);
+    });
+}
+
+// the few edge samples run in plain double
+void antialias_tile(const MixedRectangle& view, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id) {
+    antialias_tile(view.rec, window, max_iter, tile_id, thread_id);
+}
+
+void antialias_tile(const RectangleAP& mandelbrot_rec, Window& window, uint64_t max_iter, uint64_t tile_id, uint64_t thread_id) {
+    MandelbrotVectors& mandelbrot_vectors = thread_mandelbrot_vectors[thread_id];
+    DrawVectors& draw_vectors = thread_draw_vectors[thread_id];
+
+    Vector2AP& unit = draw_vectors.unit;
+    mpfr_div_d(unit.x, mandelbrot_rec.width, window.graph_rec.width, MPFR_RNDN);
+    mpfr_div_d(unit.y, mandelbrot_rec.height, window.graph_rec.height, MPFR_RNDN);
+    Vector2AP& graph_point = draw_vectors.graph_point;
+    bool cycles = window.interior != INTERIOR_OFF;
+
+    antialias_tile(window, max_iter, tile_id, thread_id, [&](double x, double y, ThreadStats& stats) {
+        mpfr_mul_d(graph_point.x, unit.x, x, MPFR_RNDN);
+        mpfr_add(graph_point.x, graph_point.x, mandelbrot_rec.x, MPFR_RNDN);
+        mpfr_mul_d(graph_point.y, unit.y, y, MPFR_RNDN);
+        mpfr_sub(graph_point.y, mandelbrot_rec.y, graph_point.y, MPFR_RNDN);
+
+        double mag_squared;
+        OrbitCycle cycle;
+        uint64_t n = cycles ? in_mandelbrot_set<false, true>(graph_point, mandelbrot_vectors, max_iter, mag_squared, nullptr, &cycle)
+                            : in_mandelbrot_set(graph_point, mandelbrot_vectors, max_iter, mag_squared);
+        stats.iterations += n > 0 ? n : cycle.period > 0 ? cycle.iterations : max_iter;
+        return n > 0 ? smooth_iteration(n, mag_squared) : inside_smooth(&cycle);
+    });
+}
+
+template <typename T>
+T scalar_from_mpfr(mpfr_srcptr value) {
+    if constexpr (std::is_same_v<T, float>) {
+        return mpfr_get_flt(value, MPFR_RNDN);
+    } else if constexpr (std::is_same_v<T, long double>) {
+        return mpfr_get_ld(value, MPFR_RNDN);
+    } else if constexpr (std::is_same_v<T, DoubleDouble>) {
+        double hi = mpfr_get_d(value, MPFR_RNDN);
+        mpfr_t rest;
+        mpfr_init2(rest, mpfr_get_prec(value));
+        mpfr_sub_d(rest, value, hi, MPFR_RNDN);
+        double lo = mpfr_get_d(rest, MPFR_RNDN);
+        mpfr_clear(rest);
+        return {hi, lo};
+    } else {
+        return mpfr_get_d(value, MPFR_RNDN);
+    }
+}
+
+template <typename T>
+RectangleT<T> rectangle_as(const RectangleD& rec) {
+    return {T(rec.x), T(rec.y), T(rec.width), T(rec.height)};
+}
+
+template <typename T>
+RectangleT<T> rectangle_as(const RectangleAP& rec) {
+    return {scalar_from_mpfr<T>(rec.x), scalar_from_mpfr<T>(rec.y), scalar_from_mpfr<T>(rec.width), scalar_from_mpfr<T>(rec.height)};
+}
+
+// log2 of the pixel spacing of the current view
+double view_log2_unit(const Window& window, const Mandelbrot& mandelbrot, ComputeMode compute_mode) {
+    if (compute_mode == DOUBLE) return std::log2(mandelbrot.mandelbrot_rec_d.width / window.graph_rec.width);
+
+    // width may be below the double range
+    long exponent;
+    double mantissa = mpfr_get_d_2exp(&exponent, mandelbrot.mandelbrot_rec_mpfr.width, MPFR_RNDN);
+    return exponent + std::log2(std::abs(mantissa)) - std::log2(window.graph_rec.width);
+}
+
+// the scalar type for the current view, window.scalar unless that is auto
+ScalarType view_scalar(const Window& window, const Mandelbrot& mandelbrot, ComputeMode compute_mode) {
+    ScalarType scalar = window.scalar;
+    if (scalar == SCALAR_MPFR && compute_mode == DOUBLE) scalar = SCALAR_DOUBLE;
+    if (scalar != SCALAR_AUTO) return scalar;
+
+    RectangleD rec = mandelbrot.mandelbrot_rec_d;
+    if (compute_mode == MPFR) rec = rectangle_as<double>(mandelbrot.mandelbrot_rec_mpfr);
+    double log2_unit = view_log2_unit(window, mandelbrot, compute_mode);
+    double extent = std::max({2.0, std::abs(rec.x), std::abs(rec.x + rec.width), std::abs(rec.y), std::abs(rec.y - rec.height)});
+    return pick_scalar(std::log2(extent), log2_unit, compute_mode);
+}
+
+// calls render(rec) with the view in the scalar type, RectangleAP for mpfr
+template <typename Render>
+void with_scalar_view(ScalarType scalar, ComputeMode compute_mode, const Mandelbrot& mandelbrot, Render&& render) {
+    auto convert = [&]<typename T>() {
+        if (compute_mode == MPFR) render(rectangle_as<T>(mandelbrot.mandelbrot_rec_mpfr));
+        else render(rectangle_as<T>(mandelbrot.mandelbrot_rec_d));
+    };
+
+    if (scalar == SCALAR_FLOAT) convert.template operator()<float>();
+    else if (scalar == SCALAR_FLOAT_DOUBLE) {
+        if (compute_mode == MPFR) render(MixedRectangle{rectangle_as<double>(mandelbrot.mandelbrot_rec_mpfr)});
+        else render(MixedRectangle{mandelbrot.mandelbrot_rec_d});
+    }
+    else if (scalar == SCALAR_LONG_DOUBLE) convert.template operator()<long double>();
+    else if (scalar == SCALAR_DOUBLE_DOUBLE) convert.template operator()<DoubleDouble>();
+    else if (scalar == SCALAR_MPFR) render(mandelbrot.mandelbrot_rec_mpfr);
+    else convert.template operator()<double>();
+}
+
+// tiles by distance of their center from the focus, in pixels
+void sort_by_focus(const Window& window, std::vector<uint64_t>::iterator begin, std::vector<uint64_t>::iterator end, uint64_t focus) {
+    double focus_x = std::bit_cast<float>((uint32_t)(focus >> 32)) * window.graph_rec.width;
+    double focus_y = std::bit_cast<float>((uint32_t)focus) * window.graph_rec.height;
+    auto distance = [&](uint64_t tile_id) {
+        const RectangleD& tile = window.tiles[tile_id];
+        double dx = tile.x + tile.width / 2 - focus_x;
+        double dy = tile.y + tile.height / 2 - focus_y;
+        return dx * dx + dy * dy;
+    };
+    std::stable_sort(begin, end, [&](uint64_t a, uint64_t b) {
+        return distance(a) < distance(b);
+    });
+}
+
+// renders the current view into window.graph_image and window.iterations, blocks until all tiles are done.
+// The workers pull window.tiles nearest to render_focus first. With frame_buffers the calling thread
+// publishes finished tiles while the workers are still running. With window.aa_grid set, a second pass
+// over all tiles supersamples the edge pixels once every pixel of the first pass is known.
+void render_mandelbrot(Window& window, const Mandelbrot& mandelbrot, ComputeMode compute_mode, uint64_t max_iter, uint64_t num_threads, RenderTimes* times = nullptr, FrameBuffers* frame_buffers = nullptr) {
+    uint64_t tile_count = window.tiles.size();
+
+    for (int i = 0; i < num_threads; ++i) {
+        thread_stats[i] = {};
+    }
+
+    if (times) times->start = std::chrono::steady_clock::now();
+
+    // one pass over item_count work items, render_item(item, thread_id) runs on the workers.
+    // With tiles the items are those tile ids and go to the frame buffers as they finish. They are
+    // taken nearest to render_focus first, when the focus moves the tiles not taken yet are sorted again.
+    auto run_items = [&](const std::vector<uint64_t>* tiles, uint64_t item_count, auto&& render_item) {
+        std::vector<std::jthread> render_workers;
+        std::vector<uint64_t> order;
+        uint64_t focus = render_focus.load(std::memory_order_relaxed);
+        uint64_t next_tile = 0;
+        std::mutex order_mtx;
+        if (tiles) {
+            order = *tiles;
+            sort_by_focus(window, order.begin(), order.end(), focus);
+        }
+
+        std::mutex done_mtx;
+        std::condition_variable done_cv;
+        std::vector<uint64_t> done_tiles;
+
+        {
+            TRACE_ZONE("spawn");
+            for (int i = 0; i < num_threads; ++i) {
+                render_workers.emplace_back([&, i] {
+                    while (!render_cancel.load(std::memory_order_relaxed)) {
+                        uint64_t tile_id;
+                        {
+                            std::lock_guard<std::mutex> lock(order_mtx);
+                            if (next_tile >= item_count) break;
+                            uint64_t moved = render_focus.load(std::memory_order_relaxed);
+                            if (tiles && moved != focus) {
+                                focus = moved;
+                                sort_by_focus(window, order.begin() + next_tile, order.end(), focus);
+                            }
+                            tile_id = tiles ? order[next_tile] : next_tile;
+                            next_tile += 1;
+                        }
+                        render_item(tile_id, i);
+
+                        if (times) {
+                            std::call_once(times->first_tile_flag, [times] {
+                                times->first_tile = std::chrono::steady_clock::now();
+                            });
+                        }
+
+                        std::lock_guard<std::mutex> lock(done_mtx);
+                        done_tiles.push_back(tile_id);
+                        done_cv.notify_one();
+                    }
+                });
+            }
+        }
+
+        if (frame_buffers && tiles) {
+            uint64_t published = 0;
+            std::vector<uint64_t> publish_tiles;
+            std::unique_lock<std::mutex> lock(done_mtx);
+
+            while (published < item_count && !render_cancel.load(std::memory_order_relaxed)) {
+                // at most one publish per interval, unless the last tile finished
+                done_cv.wait_until(lock, std::chrono::steady_clock::now() + publish_interval, [&] {
+                    return published + done_tiles.size() == item_count;
+                });
+                if (done_tiles.empty()) continue;
+
+                publish_tiles.swap(done_tiles);
+                done_tiles.clear();
+                published += publish_tiles.size();
+
+                lock.unlock();
+                {
+                    TRACE_ZONE("publish");
+                    frame_buffers->publish(window.graph_image, window.tiles, publish_tiles);
+                }
+                lock.lock();
+            }
+        }
+
+        TRACE_ZONE("join");
+        for (auto& t: render_workers) { 
+            t.join();
+        }
+    };
+
+    // tiles made of mirrored rows only are left out, the rest is scheduled as usual
+    set_mirror_rows(window, mandelbrot, compute_mode);
+    window.mirrored_pixels = 0;
+    std::vector<uint64_t> computed_tiles;
+    for (uint64_t tile_id = 0; tile_id < tile_count; ++tile_id) {
+        const RectangleD& tile = window.tiles[tile_id];
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            if (mirrored_row(window, y)) continue;
+            computed_tiles.push_back(tile_id);
+            break;
+        }
+    }
+
+    auto run_tiles = [&](auto&& render_tile) {
+        run_items(&computed_tiles, computed_tiles.size(), render_tile);
+    };
+    auto publish_mirrored = [&](bool image_only) {
+        std::vector<uint64_t> mirrored_tiles = mirror_rows(window, image_only);
+        if (frame_buffers && !mirrored_tiles.empty()) frame_buffers->publish(window.graph_image, window.tiles, mirrored_tiles);
+    };
+
+    window.scalar_used = view_scalar(window, mandelbrot, compute_mode);
+
+    with_scalar_view(window.scalar_used, compute_mode, mandelbrot, [&](const auto& mandelbrot_rec) {
+        using Survivor = typename SurvivorOrbit<std::decay_t<decltype(mandelbrot_rec)>>::type;
+        bool two_phase = false;
+
+        // two-phase: every tile to phase_one_iterations first, then the orbits still inside as one list
+        if constexpr (!std::is_void_v<Survivor> && !distance_estimation) {
+            if (window.kernel == KERNEL_INTERLEAVED && window.strategy == STRATEGY_FULL && max_iter > phase_one_iterations) {
+                two_phase = true;
+                std::vector<std::vector<Survivor>> tile_survivors(tile_count);
+                run_tiles([&](uint64_t tile_id, uint64_t thread_id) {
+                    TRACE_ZONE("tile");
+                    draw_mandelbrot_image(mandelbrot_rec, window, max_iter, tile_id, thread_id, &tile_survivors[tile_id]);
+                });
+
+                std::vector<Survivor> survivors;
+                std::vector<uint64_t> survivor_tiles;
+                for (uint64_t tile_id = 0; tile_id < tile_count; ++tile_id) {
+                    if (tile_survivors[tile_id].empty()) continue;
+                    survivors.insert(survivors.end(), tile_survivors[tile_id].begin(), tile_survivors[tile_id].end());
+                    survivor_tiles.push_back(tile_id);
+                }
+                uint64_t chunks = (survivors.size() + survivor_chunk - 1) / survivor_chunk;
+                run_items(nullptr, chunks, [&](uint64_t chunk, uint64_t thread_id) {
+                    TRACE_ZONE("survivors");
+                    uint64_t begin = chunk * survivor_chunk;
+                    draw_survivors(survivors, begin, std::min<uint64_t>(begin + survivor_chunk, survivors.size()), window, max_iter, thread_id);
+                });
+                if (frame_buffers && !survivor_tiles.empty()) frame_buffers->publish(window.graph_image, window.tiles, survivor_tiles);
+            }
+        }
+
+        // guessing needs the final answer on the cell borders, so no two-phase with the strategies.
+        // Filled pixels have no cycle to color, interior coloring computes every pixel.
+        if (window.strategy != STRATEGY_FULL && window.interior != INTERIOR_COLOR) {
+            run_tiles([&](uint64_t tile_id, uint64_t thread_id) {
+                TRACE_ZONE("strategy");
+                strategy_tile(mandelbrot_rec, window, max_iter, tile_id, thread_id);
+            });
+        } else if (!two_phase) {
+            run_tiles([&](uint64_t tile_id, uint64_t thread_id) {
+                TRACE_ZONE("tile");
+                draw_mandelbrot_image(mandelbrot_rec, window, max_iter, tile_id, thread_id);
+            });
+        }
+        publish_mirrored(false);
+
+        // tiles were shown with the previous frame's histogram, recolor once all counts are in
+        if (window.color_mapping == COLOR_HISTOGRAM) {
+            apply_histogram(window, max_iter, num_threads);
+            if (frame_buffers && window.aa_grid <= 1) {
+                std::vector<uint64_t> all_tiles(tile_count);
+                for (uint64_t tile_id = 0; tile_id < tile_count; ++tile_id) all_tiles[tile_id] = tile_id;
+                frame_buffers->publish(window.graph_image, window.tiles, all_tiles);
+            }
+        }
+
+        // the antialiasing pass publishes every computed tile again, that also covers the histogram recolor
+        if (window.aa_grid > 1) {
+            run_tiles([&](uint64_t tile_id, uint64_t thread_id) {
+                TRACE_ZONE("antialias");
+                antialias_tile(mandelbrot_rec, window, max_iter, tile_id, thread_id);
+            });
+            publish_mirrored(true);
+        }
+    });
+
+    if (times) times->done = std::chrono::steady_clock::now();
+}
+
+FrameStats collect_frame_stats(const Window& window, uint64_t num_threads, uint64_t max_iter, double seconds) {
+    FrameStats frame_stats;
+    frame_stats.max_iter = max_iter;
+    frame_stats.seconds = seconds;
+    frame_stats.tile_seconds = window.tile_seconds;
+    frame_stats.scalar = window.scalar_used;
+    frame_stats.mirrored_pixels = window.mirrored_pixels;
+
+    for (int i = 0; i < num_threads; ++i) {
+        const ThreadStats& stats = thread_stats[i];
+        frame_stats.pixels += stats.pixels;
+        frame_stats.iterations += stats.iterations;
+        frame_stats.escaped += stats.escaped;
+        frame_stats.max_iter_pixels += stats.max_iter_pixels;
+        frame_stats.cycle_pixels += stats.cycle_pixels;
+        frame_stats.aa_pixels += stats.aa_pixels;
+        frame_stats.guessed_pixels += stats.guessed_pixels;
+        frame_stats.thread_seconds.push_back(stats.seconds);
+    }
+    return frame_stats;
+}
+
+void write_stats_json(FILE* file, const FrameStats& frame_stats) {
+    std::println(file, "{{");
+    std::println(file, "  \"frame\": {},", frame_stats.frame);
+    std::println(file, "  \"max_iter\": {},", frame_stats.max_iter);
+    std::println(file, "  \"scalar\": \"{}\",", scalar_names[frame_stats.scalar]);
+    std::println(file, "  \"seconds\": {:.6f},", frame_stats.seconds);
+    std::println(file, "  \"pixels\": {},", frame_stats.pixels);
+    std::println(file, "  \"iterations\": {},", frame_stats.iterations);
+    std::println(file, "  \"escaped\": {},", frame_stats.escaped);
+    std::println(file, "  \"max_iter_pixels\": {},", frame_stats.max_iter_pixels);
+    std::println(file, "  \"cycle_pixels\": {},", frame_stats.cycle_pixels);
+    std::println(file, "  \"aa_pixels\": {},", frame_stats.aa_pixels);
+    std::println(file, "  \"mirrored_pixels\": {},", frame_stats.mirrored_pixels);
+    std::println(file, "  \"guessed_pixels\": {},", frame_stats.guessed_pixels);
+    std::println(file, "  \"load_imbalance\": {:.4f},", frame_stats.load_imbalance());
+    std::print(file, "  \"thread_seconds\": [");
+    for (uint64_t i = 0; i < frame_stats.thread_seconds.size(); ++i) {
+        std::print(file, "{}{:.6f}", i > 0 ? ", " : "", frame_stats.thread_seconds[i]);
+    }
+    std::println(file, "],");
+    std::print(file, "  \"tile_seconds\": [");
+    for (uint64_t i = 0; i < frame_stats.tile_seconds.size(); ++i) {
+        std::print(file, "{}{:.6f}", i > 0 ? ", " : "", frame_stats.tile_seconds[i]);
+    }
+    std::println(file, "]");
+    std::println(file, "}}");
+}
+
+bool write_stats_json(const FrameStats& frame_stats, const char* path) {
+    FILE* file = std::fopen(path, "w");
+    if (!file) return false;
+    write_stats_json(file, frame_stats);
+    std::fclose(file);
+    return true;
+}
+
+// auto max_iter: a depth estimate from the pixel spacing, times a factor that the finished frames
+// move up or down. The factor carries over to the next view, so a zoom keeps what the last one learned.
+constexpr uint64_t auto_iter_min = 64;
+constexpr uint64_t auto_iter_cap_default = 1 << 20;
+// pixel spacing where the estimate starts to grow, the home view is at 2^-8.3
+constexpr double auto_iter_depth = 8;
+// raise when more than this fraction of the pixels escapes in the upper half of max_iter
+constexpr double auto_iter_raise = 0.002;
+// lower when this quantile of the escaped pixels is below a quarter of max_iter
+constexpr double auto_iter_quantile = 0.999;
+
+struct IterationControl {
+    bool enabled = false;
+    uint64_t cap = auto_iter_cap_default;
+    double scale = 1.0;
+
+    uint64_t limit(double log2_unit) const {
+        double depth = std::max(1.0, -log2_unit / auto_iter_depth);
+        double estimate = max_iter_initial * std::pow(depth, 1.5) * scale;
+        uint64_t floor = std::min(auto_iter_min, cap);
+        if (!(estimate < (double)cap)) return cap;
+        return std::max(floor, (uint64_t)estimate);
+    }
+
+    // looks at the finished frame, true if it asks for a different max_iter
+    bool update(const Window& window, uint64_t max_iter) {
+        // escaped pixels by bit width of n, 0 is inside
+        uint64_t bins[65] = {};
+        uint64_t tail = 0;
+        for (uint64_t n : window.iterations) {
+            bins[std::bit_width(n)] += 1;
+            tail += n > max_iter / 2;
+        }
+        uint64_t escaped = window.iterations.size() - bins[0];
+
+        // upper bound of the bin the quantile falls into
+        uint64_t high = 1;
+        uint64_t below = 0;
+        for (int bin = 1; bin < 65 && below < auto_iter_quantile * escaped; ++bin) {
+            below += bins[bin];
+            high = bin < 64 ? (uint64_t)1 << bin : UINT64_MAX;
+        }
+
+        if (tail > auto_iter_raise * window.iterations.size() && max_iter < cap) {
+            scale *= 2;
+            return true;
+        }
+        // the lowered limit keeps the tail under the raise threshold, no flip-flopping
+        if (escaped > 0 && high <= max_iter / 4 && max_iter > auto_iter_min) {
+            scale /= 2;
+            return true;
+        }
+        return false;
+    }
+};
+
+// budget mode: show a preview the cost model expects within target seconds, with coarser pixels and a
+// lower limit the slower the view is, then sharper passes until the full frame while no new input comes in
+constexpr double budget_targets[] = {0, 0.016, 0.05};
+// preview pixels up to 16 x 16
+constexpr int budget_scales = 5;
+constexpr uint64_t budget_min_iter = 64;
+// what a pixel costs besides its iterations (setup, coloring, publish), in iterations
+constexpr double budget_pixel_cost = 16;
+// a pass between the preview and the full frame only if it is predicted within this many budgets
+constexpr double budget_refine_factor = 4;
+constexpr uint64_t budget_sample_stride = 61;
+
+struct BudgetPass {
+    int scale;
+    uint64_t max_iter;
+};
+
+struct FrameBudget {
+    // seconds, 0 = off
+    double target = 0;
+    // seconds per unit of work (iterations + budget_pixel_cost per pixel) with all threads, 0 until a pass ran
+    double seconds_per_work = 0;
+
+    // kernel iterations per pixel for limit cap, sampled from the last full frame. Inside pixels count
+    // as cap, so the frame of another view (or none yet) errs on the slow side.
+    double iterations_per_pixel(const Window& window, uint64_t cap) const {
+        double sum = 0;
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < window.iterations.size(); i += budget_sample_stride) {
+            uint64_t n = window.iterations[i];
+            sum += n == 0 ? cap : std::min(n, cap);
+            count += 1;
+        }
+        return count > 0 ? sum / count : cap;
+    }
+
+    double predict(const Window& window, int scale, uint64_t cap) const {
+        double pixels = window.graph_rec.width * window.graph_rec.height / (scale * scale);
+        return pixels * (iterations_per_pixel(window, cap) + budget_pixel_cost) * seconds_per_work;
+    }
+
+    // running average over the passes, also partial ones
+    void observe(const FrameStats& stats) {
+        double work = stats.iterations + budget_pixel_cost * stats.pixels;
+        if (work <= 0 || stats.seconds <= 0) return;
+        double sample = stats.seconds / work;
+        seconds_per_work = seconds_per_work > 0 ? 0.5 * (seconds_per_work + sample) : sample;
+    }
+
+    // the sharpest pass that fits: full resolution first, then a quarter of the limit, then coarser pixels.
+    // Without a cost model yet the coarsest pass, it is cheap and teaches the model.
+    BudgetPass preview(const Window& window, uint64_t max_iter) const {
+        uint64_t lowest = std::min(max_iter, budget_min_iter);
+        int coarsest = 1 << (budget_scales - 1);
+        if (seconds_per_work <= 0) return {coarsest, lowest};
+
+        for (int scale = 1; scale <= coarsest; scale *= 2) {
+            if (predict(window, scale, max_iter) <= target) return {scale, max_iter};
+            uint64_t cap = std::max(lowest, max_iter / 4);
+            if (cap < max_iter && predict(window, scale, cap) <= target) return {scale, cap};
+        }
+        return {coarsest, lowest};
+    }
+
+    // after pass: the next finer scale if it is cheap enough, else straight to the full frame
+    BudgetPass refine(const Window& window, uint64_t max_iter, BudgetPass pass) const {
+        int scale = pass.max_iter < max_iter ? pass.scale : pass.scale / 2;
+        if (scale > 1 && predict(window, scale, max_iter) <= budget_refine_factor * target) return {scale, max_iter};
+        return {1, max_iter};
+    }
+};
+
+// nearest neighbour, a preview pixel covers about scale x scale pixels of window
+void upscale_preview(const Window& preview, Window& window) {
+    const Color* from = (const Color*)preview.graph_image.data;
+    Color* to = (Color*)window.graph_image.data;
+    int width = window.graph_image.width;
+    int height = window.graph_image.height;
+    int preview_width = preview.graph_image.width;
+    int preview_height = preview.graph_image.height;
+
+    for (int y = 0; y < height; ++y) {
+        const Color* row = from + (uint64_t)(y * preview_height / height) * preview_width;
+        for (int x = 0; x < width; ++x) {
+            to[(uint64_t)y * width + x] = row[x * preview_width / width];
+        }
+    }
+}
+
+
+    // !! Immder die selben draw_recs -> vorberechnen ?
+//void draw_mandelbrot_image_d(const RectangleD& mandelbrot_rec, Window& window, uint64_t max_iter, int thread_id) {
+//
+//    std::unique_lock<std::mutex> lock(mtx);
+//
+//
+//    std::println("thread {} starting first loop", thread_id);
+//
+//    while (threads_running) {
+//
 //        cv.wait(lock, [&window,thread_id] {
 //            return window.threads_ready[thread_id];
 //        });
@@ -534,294 +3103,1665 @@ void draw_mandelbrot_image(const RectangleD& mandelbrot_rec, Window& window, uin
 //    }
 //}
 
-struct App {
+struct App {
+    Window window;
+    Mandelbrot mandelbrot;
+    bool new_input = true;
+    bool show_info = false;
+    bool show_stats = false;
+    FrameStats frame_stats;
+    uint64_t num_threads = 1;
+    uint64_t max_iter = max_iter_initial;
+    IterationControl iteration_control;
+    FrameBudget budget;
+    // budget mode previews, index log2 of the scale, created on first use
+    Window previews[budget_scales];
+    // mouse position at the last input, see render_focus
+    Vector2 input_mouse = {-1, -1};
+    ComputeMode compute_mode = DOUBLE;
+
+    // render_thread picks the view of compute_mode itself, one call for both modes
+    void init_render_threads() {
+        set_tiles(window);
+        window.render_thread = std::jthread(render_thread, std::ref(*this));
+    }
+
+    void controls() {
+        TRACE_ZONE("controls");
+        float zoom_factor = 0.1f;
+
+        if (IsKeyPressed(KEY_UP) || GetMouseWheelMove() > 0.f) {
+
+            if (compute_mode == MPFR) {
+                zoom_on_center(mandelbrot.mandelbrot_rec_mpfr, 1.f - zoom_factor);
+
+            } else if (compute_mode == DOUBLE) {
+                zoom_on_center(mandelbrot.mandelbrot_rec_d, 1.f - zoom_factor);
+            }
+
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_DOWN) || GetMouseWheelMove() < 0.f) {
+            if (compute_mode == MPFR) {
+                zoom_on_center(mandelbrot.mandelbrot_rec_mpfr, 1.f + zoom_factor);
+
+            } else if (compute_mode == DOUBLE) {
+                zoom_on_center(mandelbrot.mandelbrot_rec_d, 1.f + zoom_factor);
+            }
+            new_input = true;
+        }
+
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(GetMousePosition(), window.graph_rec)) {
+            Vector2 mouse_pos = GetMousePosition();
+
+            if (compute_mode == MPFR) {
+                mpfr_set_d(temp.x, mouse_pos.x, MPFR_RNDN);
+                mpfr_set_d(temp.y, mouse_pos.y, MPFR_RNDN);
+                RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
+                to_graph(temp, graph_rec_d, mandelbrot.mandelbrot_rec_mpfr);
+                center_on_point(temp, mandelbrot.mandelbrot_rec_mpfr);
+
+            } else if (compute_mode == DOUBLE) {
+                //print_vec(mouse_pos, "mouse_pos screen space");
+                to_graph(mouse_pos, window.graph_rec, mandelbrot.mandelbrot_rec_d);
+                //print_vec(mouse_pos, "mouse_pos graph space");
+                center_on_point({mouse_pos.x, mouse_pos.y}, mandelbrot.mandelbrot_rec_d);
+            }
+
+            new_input = true;
+        }
+
+        // M and L take over from the auto limit, I hands it back
+        if (IsKeyPressed(KEY_M)) {
+            if (max_iter * 2 < max_iter) return;
+            iteration_control.enabled = false;
+            max_iter *= 2;
+            new_input = true;
+        }
+        if (IsKeyPressed(KEY_L)) {
+            if (max_iter == 1) return;
+            iteration_control.enabled = false;
+
+            max_iter /= 2;
+            if (max_iter < 1) max_iter = 1;
+
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_I)) {
+            if (!iteration_control.enabled) {
+                iteration_control.scale = 1.0;
+                auto_max_iter = 0;
+            }
+            iteration_control.enabled = !iteration_control.enabled;
+            std::println("auto max_iter {}", iteration_control.enabled ? "on" : "off");
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_B)) {
+            uint64_t next = 0;
+            while (next < std::size(budget_targets) && budget_targets[next] != budget.target) ++next;
+            budget.target = budget_targets[(next + 1) % std::size(budget_targets)];
+            if (budget.target > 0) {
+                std::println("frame budget {:.0f} ms", budget.target * 1000.0);
+            } else {
+                std::println("frame budget off");
+            }
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_A)) {
+            window.aa_grid = window.aa_grid > 1 ? 0 : aa_grid_default;
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_C)) {
+            window.color_mapping = (ColorMapping)((window.color_mapping + 1) % COLOR_MAPPING_COUNT);
+            std::println("color mapping {}", color_mapping_names[window.color_mapping]);
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_K)) {
+            window.kernel = (OrbitKernel)((window.kernel + 1) % KERNEL_COUNT);
+            std::println("orbit kernel {}", kernel_names[window.kernel]);
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_G)) {
+            window.strategy = (RenderStrategy)((window.strategy + 1) % STRATEGY_COUNT);
+            std::println("render strategy {}", strategy_names[window.strategy]);
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_P)) {
+            window.interior = (InteriorMode)((window.interior + 1) % INTERIOR_COUNT);
+            std::println("interior {}", interior_names[window.interior]);
+            new_input = true;
+        }
+
+        if (IsKeyPressed(KEY_S)) {
+            show_stats = !show_stats;
+        }
+#ifdef PLOT_TRACE
+        if (IsKeyPressed(KEY_T)) {
+            if (write_trace_json("plot_trace.json")) std::println("trace written to plot_trace.json");
+        }
+#endif
+        if (IsKeyPressed(KEY_J)) {
+            std::lock_guard<std::mutex> stats_lock(stats_mtx);
+            if (write_stats_json(frame_stats, "render_stats.json")) {
+                std::println("render stats of frame {} written to render_stats.json", frame_stats.frame);
+            }
+        }
+
+        if (show_info) {
+            float text_size = 20;
+            Vector2 mouse_pos = GetMousePosition();
+
+            // PLEASE NO ENABLE - 8GB RAM in 1 SEK
+
+            //if (compute_mode == MPFR) {
+            //    mpfr_set_d(temp.x, mouse_pos.x, MPFR_RNDN);
+            //    mpfr_set_d(temp.y, mouse_pos.y, MPFR_RNDN);
+            //    //Vector2AP mouse_pos_mandelbrot = to_graph(mouse_pos_ap, window.graph_rec, mandelbrot.mandelbrot_rec);
+            //    RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
+            //    to_graph(temp, graph_rec_d, mandelbrot.mandelbrot_rec_mpfr);
+
+            //    window.copy_img = ImageCopy(window.graph_image);
+
+            //    ImageDrawText(&window.copy_img, TextFormat("%f, %f", mpfr_get_d(temp.x, MPFR_RNDN), mpfr_get_d(temp.y, MPFR_RNDN)), 0, 0, text_size, WHITE);
+
+            //} else if (compute_mode == DOUBLE) {
+            //    to_graph(mouse_pos, window.graph_rec, mandelbrot.mandelbrot_rec_d);
+            //    window.copy_img = ImageCopy(window.graph_image);
+            //    ImageDrawText(&window.copy_img, TextFormat("%f, %f", mouse_pos.x, mouse_pos.y), 0, 0, text_size, WHITE);
+            //}
+
+            //UpdateTexture(window.copy_texture, window.copy_img.data);
+            //DrawTexture(window.copy_texture, 0, 0, WHITE);
+        }
+
+    }
+
+    void new_frame() {
+        TRACE_ZONE("frame");
+        window.begin_frame();
+
+        // render new view to graph_image
+
+        if (new_input) {
+            
+            cv.notify_one();
+            //render_to_img();
+            //if (compute_mode == MPFR) {
+            //    window.render_to_img(mandelbrot.mandelbrot_rec_mpfr, num_threads, max_iter);
+
+            //} else if (compute_mode == DOUBLE) {
+            //    window.render_to_img(mandelbrot.mandelbrot_rec_d, num_threads, max_iter);
+            //}
+            //new_input = false;
+        }
+
+        // fresh input makes a budgeted render drop what it is doing and start over with a preview
+        // M and L go on from the limit auto max_iter picked last
+        uint64_t picked = auto_max_iter.load();
+        if (iteration_control.enabled && picked > 0) max_iter = picked;
+
+        bool input_pending = new_input;
+        controls();
+        if (budget.target > 0 && new_input && !input_pending) render_cancel = true;
+
+        // tiles go out around the mouse once it moved away from where the last input happened, a click
+        // or zoom puts the interesting part in the centre
+        Vector2 mouse = GetMousePosition();
+        if (new_input && !input_pending) input_mouse = mouse;
+        if (CheckCollisionPointRec(mouse, window.graph_rec) && (mouse.x != input_mouse.x || mouse.y != input_mouse.y)) {
+            render_focus = pack_focus((mouse.x - window.graph_rec.x) / window.graph_rec.width, (mouse.y - window.graph_rec.y) / window.graph_rec.height);
+        } else {
+            render_focus = pack_focus(0.5f, 0.5f);
+        }
+
+        // draw current view from graph_image on screen
+        Color tint = WHITE;
+        if (show_info) tint.a = 128;
+
+        if (show_stats) {
+            FrameStats stats;
+            {
+                std::lock_guard<std::mutex> stats_lock(stats_mtx);
+                stats = frame_stats;
+            }
+            window.draw_frame(tint, &stats);
+        } else {
+            window.draw_frame(tint);
+        }
+
+    }
+
+    void stop_threads() {
+        //threads_running = false;
+        //for (uint64_t& ready : window.threads_ready) {
+        //    ready = true;
+        //}
+        //cv.notify_all();
+        //for (std::thread& t : window.render_jobs) {
+        //    t.join();
+        //}
+        //
+        window.render_thread.request_stop();
+        new_input = true;
+        cv.notify_one();
+    }
+
+    void init_mpfr_containers(uint64_t num_threads) {
+        mpfr_init(temp.x);
+        mpfr_init(temp.y);
+
+        mpfr_init(dif_halved);
+        mpfr_init(tmp);
+
+        for(int i = 0; i < num_threads; ++i) {
+            thread_mandelbrot_vectors[i].init();
+            thread_draw_vectors[i].init();
+        }
+    }
+
+};
+
+// everything except the raylib window and textures, usable without a display
+Window init_headless_window(int width, int height) {
     Window window;
-    Mandelbrot mandelbrot;
-    bool new_input = true;
-    bool show_info = false;
-    uint64_t num_threads = 1;
-    uint64_t max_iter = max_iter_initial;
-    ComputeMode compute_mode = DOUBLE;
+    window.screen_size = {(float)width, (float)height};
+    window.graph_rec = {0, 0, (float)width, (float)height};
+    window.bg_color = BLACK;
+
+    window.graph_image = GenImageColor(window.graph_rec.width, window.graph_rec.height, window.bg_color);
+    window.iterations.resize((uint64_t)width * height);
+    window.smooth.resize((uint64_t)width * height);
+    if constexpr (distance_estimation) window.distance.resize((uint64_t)width * height);
+
+    set_tiles(window);
+
+    return window;
+}
+
+// one render_mandelbrot of the current view into window, its stats become the frame stats
+FrameStats render_pass(App& app, Window& window, uint64_t max_iter, FrameBuffers* frame_buffers) {
+    RenderTimes times;
+    render_mandelbrot(window, app.mandelbrot, app.compute_mode, max_iter, app.num_threads, &times, frame_buffers);
+
+    FrameStats stats = collect_frame_stats(window, app.num_threads, max_iter, std::chrono::duration<double>(times.done - times.start).count());
+    std::lock_guard<std::mutex> stats_lock(stats_mtx);
+    stats.frame = app.frame_stats.frame + 1;
+    app.frame_stats = stats;
+    return stats;
+}
 
-    void init_render_threads(uint64_t max_iter, uint64_t num_threads, RectangleD& mandelbrot_rec, Window& window) {
+// budget mode, see FrameBudget. False if new input cut it short.
+bool render_budgeted(App& app, uint64_t max_iter) {
+    Window& window = app.window;
+    BudgetPass pass = app.budget.preview(window, max_iter);
+
+    while (!render_cancel.load(std::memory_order_relaxed)) {
+        TRACE_ZONE("budget pass");
+        if (pass.scale == 1) {
+            app.budget.observe(render_pass(app, window, pass.max_iter, window.frame_buffers.get()));
+            if (pass.max_iter == max_iter) return !render_cancel.load(std::memory_order_relaxed);
+
+        } else {
+            Window& preview = app.previews[std::countr_zero((unsigned)pass.scale)];
+            if (preview.iterations.empty()) {
+                int width = (window.graph_image.width + pass.scale - 1) / pass.scale;
+                int height = (window.graph_image.height + pass.scale - 1) / pass.scale;
+                preview = init_headless_window(width, height);
+            }
+            preview.color_mapping = window.color_mapping;
+            preview.scalar = window.scalar;
+            preview.kernel = window.kernel;
+            preview.strategy = window.strategy;
+            preview.interior = window.interior;
+
+            app.budget.observe(render_pass(app, preview, pass.max_iter, nullptr));
+            if (render_cancel.load(std::memory_order_relaxed)) break;
+
+            upscale_preview(preview, window);
+            if (window.frame_buffers) {
+                std::vector<uint64_t> all_tiles(window.tiles.size());
+                for (uint64_t tile_id = 0; tile_id < all_tiles.size(); ++tile_id) all_tiles[tile_id] = tile_id;
+                window.frame_buffers->publish(window.graph_image, window.tiles, all_tiles);
+            }
+        }
+        pass = app.budget.refine(window, max_iter, pass);
+    }
+    return false;
+}
 
-        float width = window.graph_rec.width / num_threads;
-        for (int i = 0; i < num_threads; ++i) {
-            window.draw_recs[i] = {i * width, 0.f, width, window.graph_rec.height};
+void render_thread(std::stop_token st, App& app) {
+    TRACE_THREAD_NAME("render");
+    std::unique_lock<std::mutex> lock(mtx);
 
-            //window.render_jobs.emplace_back(draw_mandelbrot_image_d, std::cref(mandelbrot_rec), std::ref(window), max_iter, i);
 
-            //window.threads_ready.emplace_back(false);
+    while (!st.stop_requested()) {
+        cv.wait(lock, [&app] {
+            return app.new_input;
+        });
+        if (st.stop_requested()) {
+            break;
         }
-        window.render_thread = std::jthread(render_thread, std::ref(*this));
+        app.new_input = false;
+        render_cancel = false;
+
+        TRACE_ZONE("render");
+        // render again right away if the frame wants another limit, the cap and floor stop it
+        bool done;
+        bool auto_iter = app.iteration_control.enabled;
+        uint64_t max_iter = app.max_iter;
+        do {
+            if (auto_iter) {
+                max_iter = app.iteration_control.limit(view_log2_unit(app.window, app.mandelbrot, app.compute_mode));
+                auto_max_iter = max_iter;
+            }
+            if (app.budget.target > 0) {
+                done = render_budgeted(app, max_iter);
+            } else {
+                render_pass(app, app.window, max_iter, app.window.frame_buffers.get());
+                done = true;
+            }
+        } while (done && auto_iter && app.iteration_control.update(app.window, max_iter));
+
+        // cut short by input that may already be taken, the next round picks up the current view
+        if (!done) app.new_input = true;
+
+        //draw_axis(app.mandelbrot.mandelbrot_rec_d);
+
+    } 
+}
+
+Window init_window(int width, int height, const char* title) {
+    Window window = init_headless_window(width, height);
+
+    InitWindow(window.screen_size.x, window.screen_size.y, title);
+    SetTraceLogLevel(LOG_WARNING);
+    SetTargetFPS(120);
+
+    window.graph_texture = LoadTextureFromImage(window.graph_image);
+    window.frame_buffers = std::make_unique<FrameBuffers>(window.graph_image.width, window.graph_image.height, window.bg_color, window.tiles.size());
+
+    window.copy_img = ImageCopy(window.graph_image);
+    window.copy_texture = LoadTextureFromImage(window.copy_img);
+
+    return window;
+}
+
+
+
+App init_app(int width, int height, const char* title, uint64_t num_threads) {
+    App app;
+
+    app.compute_mode = DOUBLE;
+    app.num_threads = num_threads;
+
+    mpfr_set_default_prec(float_precision);
+    app.init_mpfr_containers(num_threads);
+
+    app.mandelbrot.mandelbrot_rec_d = {-2.2f, 1.f, 3.2f, 2.f};
+
+    app.mandelbrot.mandelbrot_rec_mpfr.init();
+    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.x,      -2.2f, MPFR_RNDN);
+    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.y,       1.f,  MPFR_RNDN);
+    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.width,   3.2f, MPFR_RNDN);
+    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.height,  2.f,  MPFR_RNDN);
+
+    // MUSS LAST SEIN - > BRAUCHT DIE MANDELBROT DATEN
+
+    app.window = init_window(width, height, title);
+
+    app.init_render_threads();
 
+    return app;
+}
+
+
+// distributed: how long the coordinator waits without any tile in flight, and the default per tile
+constexpr double worker_timeout_seconds = 30.0;
+
+struct HeadlessOptions {
+    // center as strings so MPFR mode keeps all digits
+    std::string center_x = "-0.6";
+    std::string center_y = "0";
+    double zoom = 1.0;
+    int width = window_width;
+    int height = window_height;
+    uint64_t max_iter = max_iter_initial;
+    // --max-iter auto: depth estimate, refined from the rendered frame up to the cap
+    bool auto_max_iter = false;
+    uint64_t max_iter_cap = auto_iter_cap_default;
+    ComputeMode compute_mode = DOUBLE;
+    ColorMapping color_mapping = COLOR_MODULO;
+    int aa_grid = 0;
+    ScalarType scalar = SCALAR_AUTO;
+    OrbitKernel kernel = KERNEL_INTERLEAVED;
+    RenderStrategy strategy = STRATEGY_FULL;
+    InteriorMode interior = INTERIOR_OFF;
+    uint64_t num_threads = 0;
+    std::string out_path = "mandelbrot.png";
+
+    // zoom video: frames > 1 renders a sequence from zoom 1 to zoom, out is the file prefix
+    uint64_t frames = 0;
+    uint64_t keyframe_interval = 0;
+
+    // distributed: listen for --worker processes and hand them tiles
+    std::string listen_address;
+    uint64_t spawn_workers = 0;
+    int tile_size = 128;
+    // seconds a worker may spend on one tile before it counts as hung
+    double tile_timeout = worker_timeout_seconds;
+    bool num_threads_set = false;
+
+    std::string stats_path;
+};
+
+void print_headless_usage() {
+    std::println(stderr, "usage: plot --headless [options]");
+    std::println(stderr, "  --center X,Y      view center (default {},{})", view_center_x, view_center_y);
+    std::println(stderr, "  --zoom Z          magnification, 1 = default view width {}", view_width);
+    std::println(stderr, "  --size WxH        image size in pixels (default {}x{})", window_width, window_height);
+    std::println(stderr, "  --max-iter N      iteration limit, auto picks it from the zoom depth and the rendered frame");
+    std::println(stderr, "                    (default {}, --frames and --listen use the depth estimate only)", max_iter_initial);
+    std::println(stderr, "  --max-iter-cap N  upper bound for --max-iter auto (default {})", auto_iter_cap_default);
+    std::println(stderr, "  --mode M          double | mpfr");
+    std::println(stderr, "  --scalar T        auto | float | float-double | double | long-double | double-double | mpfr (default auto,");
+    std::println(stderr, "                    the cheapest type that resolves the pixel spacing)");
+    std::println(stderr, "  --kernel K        plain | interleaved, several orbits per row at once (default interleaved)");
+    std::println(stderr, "  --strategy S      full | guess | certify, guess fills cells whose border and middle cross are");
+    std::println(stderr, "                    inside (heuristic, can miss lone escaped pixels), certify skips blocks");
+    std::println(stderr, "                    proven inside (default full)");
+    std::println(stderr, "  --interior I      off | detect | color, stop inside orbits on an attracting cycle, color shades them");
+    std::println(stderr, "                    by period and multiplier (default off)");
+    std::println(stderr, "  --color C         modulo | log | histogram (default modulo)");
+    std::println(stderr, "  --aa N            N x N samples for edge pixels, 0 = off (default 0, not for --frames / --listen)");
+    std::println(stderr, "  --threads N       render threads (default hardware threads)");
+    std::println(stderr, "  --out FILE        .png writes the colored image, .raw the uint64 iteration buffer");
+    if (distance_estimation) {
+        std::println(stderr, "                    .dist the float exterior distance in pixels");
     }
+    std::println(stderr, "  --frames N        zoom video from zoom 1 to --zoom, --out is the frame prefix");
+    std::println(stderr, "  --keyframes K     zoom video: also full render every Kth frame and compare");
+    std::println(stderr, "  --listen ADDR     distribute tiles to workers (plot --worker --connect ADDR),");
+    std::println(stderr, "                    ADDR is host:port or unix:/path");
+    std::println(stderr, "  --spawn-workers N start N local workers, --threads is then per worker");
+    std::println(stderr, "  --tile N          distributed tile size in pixels (default 128)");
+    std::println(stderr, "  --tile-timeout S  drop a worker that takes longer for one tile and reissue its tiles,");
+    std::println(stderr, "                    raise it for deep tiles (default {:.0f})", worker_timeout_seconds);
+    std::println(stderr, "  --stats FILE      write the render counters as json");
+}
 
-    void init_render_threads(uint64_t max_iter, uint64_t num_threads, RectangleAP& mandelbrot_rec, Window& window) {
+bool parse_headless_args(int argc, char** argv, HeadlessOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--headless") continue;
 
-        float width = window.graph_rec.width / num_threads;
-    //    for (int i = 0; i < num_threads; ++i) {
-    //        window.draw_recs[i] = {i * width, 0.f, width, window.graph_rec.height};
+        if (i + 1 >= argc) {
+            std::println(stderr, "missing value for {}", arg);
+            return false;
+        }
+        std::string_view value = argv[++i];
+
+        if (arg == "--center") {
+            uint64_t comma = value.find(',');
+            if (comma == std::string_view::npos) return false;
+            options.center_x = value.substr(0, comma);
+            options.center_y = value.substr(comma + 1);
+
+        } else if (arg == "--zoom") {
+            options.zoom = std::strtod(value.data(), nullptr);
+            if (options.zoom <= 0) return false;
+
+        } else if (arg == "--size") {
+            if (std::sscanf(value.data(), "%dx%d", &options.width, &options.height) != 2) return false;
+            if (options.width <= 0 || options.height <= 0) return false;
+
+        } else if (arg == "--max-iter") {
+            options.auto_max_iter = value == "auto";
+            if (options.auto_max_iter) continue;
+            options.max_iter = std::strtoull(value.data(), nullptr, 10);
+            if (options.max_iter == 0) return false;
+
+        } else if (arg == "--max-iter-cap") {
+            options.max_iter_cap = std::strtoull(value.data(), nullptr, 10);
+            if (options.max_iter_cap == 0) return false;
+
+        } else if (arg == "--mode") {
+            if (value == "double") options.compute_mode = DOUBLE;
+            else if (value == "mpfr") options.compute_mode = MPFR;
+            else return false;
+
+        } else if (arg == "--color") {
+            auto name = std::find(std::begin(color_mapping_names), std::end(color_mapping_names), value);
+            if (name == std::end(color_mapping_names)) return false;
+            options.color_mapping = (ColorMapping)(name - std::begin(color_mapping_names));
+
+        } else if (arg == "--scalar") {
+            auto name = std::find(std::begin(scalar_names), std::end(scalar_names), value);
+            if (name == std::end(scalar_names)) return false;
+            options.scalar = (ScalarType)(name - std::begin(scalar_names));
+
+        } else if (arg == "--kernel") {
+            auto name = std::find(std::begin(kernel_names), std::end(kernel_names), value);
+            if (name == std::end(kernel_names)) return false;
+            options.kernel = (OrbitKernel)(name - std::begin(kernel_names));
+        } else if (arg == "--strategy") {
+            auto name = std::find(std::begin(strategy_names), std::end(strategy_names), value);
+            if (name == std::end(strategy_names)) return false;
+            options.strategy = (RenderStrategy)(name - std::begin(strategy_names));
+        } else if (arg == "--interior") {
+            auto name = std::find(std::begin(interior_names), std::end(interior_names), value);
+            if (name == std::end(interior_names)) return false;
+            options.interior = (InteriorMode)(name - std::begin(interior_names));
+
+        } else if (arg == "--aa") {
+            options.aa_grid = std::strtol(value.data(), nullptr, 10);
+            if (options.aa_grid < 0) return false;
+
+        } else if (arg == "--threads") {
+            options.num_threads = std::strtoull(value.data(), nullptr, 10);
+
+        } else if (arg == "--out") {
+            options.out_path = value;
+
+        } else if (arg == "--frames") {
+            options.frames = std::strtoull(value.data(), nullptr, 10);
+
+        } else if (arg == "--keyframes") {
+            options.keyframe_interval = std::strtoull(value.data(), nullptr, 10);
+
+        } else if (arg == "--listen") {
+            options.listen_address = value;
+
+        } else if (arg == "--spawn-workers") {
+            options.spawn_workers = std::strtoull(value.data(), nullptr, 10);
+
+        } else if (arg == "--stats") {
+            options.stats_path = value;
+
+        } else if (arg == "--tile") {
+            options.tile_size = std::strtol(value.data(), nullptr, 10);
+            if (options.tile_size <= 0) return false;
+
+        } else if (arg == "--tile-timeout") {
+            options.tile_timeout = std::strtod(value.data(), nullptr);
+            if (options.tile_timeout <= 0) return false;
+
+        } else {
+            std::println(stderr, "unknown option {}", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+// sets both rectangles of the view, height follows the image aspect so pixels stay square
+void set_view(Mandelbrot& mandelbrot, const std::string& center_x, const std::string& center_y, double zoom, int width, int height) {
+    double view_w = view_width / zoom;
+    double view_h = view_w * height / width;
+
+    RectangleAP& rec = mandelbrot.mandelbrot_rec_mpfr;
+    mpfr_set_d(rec.width, view_w, MPFR_RNDN);
+    mpfr_set_d(rec.height, view_h, MPFR_RNDN);
+
+    mpfr_set_str(rec.x, center_x.c_str(), 10, MPFR_RNDN);
+    mpfr_set_str(rec.y, center_y.c_str(), 10, MPFR_RNDN);
+    mpfr_div_d(tmp, rec.width, 2.f, MPFR_RNDN);
+    mpfr_sub(rec.x, rec.x, tmp, MPFR_RNDN);
+    mpfr_div_d(tmp, rec.height, 2.f, MPFR_RNDN);
+    mpfr_add(rec.y, rec.y, tmp, MPFR_RNDN);
+
+    mandelbrot.mandelbrot_rec_d = {mpfr_get_d(rec.x, MPFR_RNDN), mpfr_get_d(rec.y, MPFR_RNDN), view_w, view_h};
+}
+
+uint64_t default_num_threads() {
+    uint64_t num_threads = std::thread::hardware_concurrency();
+    if (num_threads > max_threads) num_threads = max_threads;
+    if (num_threads == 0) num_threads = 1;
+    return num_threads;
+}
+
+// same as init_app but without a raylib window and without the interactive render thread
+App init_headless_app(int width, int height, uint64_t max_iter, uint64_t num_threads) {
+    App app;
+
+    app.num_threads = num_threads;
+    app.max_iter = max_iter;
+
+    mpfr_set_default_prec(float_precision);
+    app.init_mpfr_containers(num_threads);
+    app.mandelbrot.mandelbrot_rec_mpfr.init();
 
-    //        window.render_jobs.emplace_back(draw_mandelbrot_image_mpfr, std::ref(thread_mandelbrot_vectors[i]), std::ref(thread_draw_vectors[i]), std::cref(mandelbrot_rec), std::ref(window), max_iter, i);
+    app.window = init_headless_window(width, height);
 
-    //        window.threads_ready.emplace_back(false);
-    //    }
+    return app;
+}
 
-    }
+bool write_distance(const Window& window, const char* path) {
+    FILE* file = std::fopen(path, "wb");
+    if (!file) return false;
+    uint64_t written = std::fwrite(window.distance.data(), sizeof(float), window.distance.size(), file);
+    std::fclose(file);
+    return written == window.distance.size();
+}
 
-    void controls() {
-        float zoom_factor = 0.1f;
+bool write_iterations(const Window& window, const char* path) {
+    FILE* file = std::fopen(path, "wb");
+    if (!file) return false;
+    uint64_t written = std::fwrite(window.iterations.data(), sizeof(uint64_t), window.iterations.size(), file);
+    std::fclose(file);
+    return written == window.iterations.size();
+}
 
-        if (IsKeyPressed(KEY_UP) || GetMouseWheelMove() > 0.f) {
+// Exponential map of a zoom path: sample (row, column) sits at radius r_max * exp(-row * log_step)
+// and angle 2 pi column / columns around the zoom center. log_step = 2 pi / columns keeps the
+// samples square, so every frame of the zoom is a resampling of a band of rows.
+struct ExpMap {
+    std::string center_x;
+    std::string center_y;
+    Vector2D center;
+
+    double r_max;
+    double log_step;
+    uint64_t columns;
+    uint64_t rows;
+
+    // colored samples, a row stays empty until it is needed and is freed once the zoom passed it
+    std::vector<std::vector<Color>> strip;
+    uint64_t rows_done = 0;
+};
 
-            if (compute_mode == MPFR) {
-                zoom_on_center(mandelbrot.mandelbrot_rec_mpfr, 1.f - zoom_factor);
+ExpMap init_exp_map(const HeadlessOptions& options) {
+    ExpMap map;
+    map.center_x = options.center_x;
+    map.center_y = options.center_y;
+    map.center = {std::strtod(options.center_x.c_str(), nullptr), std::strtod(options.center_y.c_str(), nullptr)};
+
+    double half_diagonal = std::sqrt((double)options.width * options.width + (double)options.height * options.height) / 2.0;
+    double first_unit = view_width / options.width;
+    double last_unit = first_unit / options.zoom;
+
+    // outer ring of the first frame has about one sample per pixel along its circumference
+    map.columns = std::ceil(2.0 * std::numbers::pi * half_diagonal);
+    map.log_step = 2.0 * std::numbers::pi / map.columns;
+    map.r_max = first_unit * half_diagonal;
+    double r_min = last_unit * 0.5;
+    map.rows = std::ceil(std::log(map.r_max / r_min) / map.log_step) + 2;
+    map.strip.resize(map.rows);
+
+    return map;
+}
 
-            } else if (compute_mode == DOUBLE) {
-                zoom_on_center(mandelbrot.mandelbrot_rec_d, 1.f - zoom_factor);
-            }
+void render_exp_map_rows(ExpMap& map, Window& window, ComputeMode compute_mode, uint64_t max_iter, uint64_t num_threads, uint64_t row_begin, uint64_t row_end) {
+    std::vector<std::jthread> render_workers;
 
-            new_input = true;
-        }
+    for (uint64_t row = row_begin; row < row_end; ++row) {
+        map.strip[row].resize(map.columns);
+    }
 
-        if (IsKeyPressed(KEY_DOWN) || GetMouseWheelMove() < 0.f) {
+    for (int i = 0; i < num_threads; ++i) {
+        render_workers.emplace_back([&map, &window, compute_mode, max_iter, num_threads, row_begin, row_end, i] {
+            Vector2AP& point_ap = thread_draw_vectors[i].graph_point;
+            Vector2AP& center_ap = thread_draw_vectors[i].top_left;
             if (compute_mode == MPFR) {
-                zoom_on_center(mandelbrot.mandelbrot_rec_mpfr, 1.f + zoom_factor);
+                mpfr_set_str(center_ap.x, map.center_x.c_str(), 10, MPFR_RNDN);
+                mpfr_set_str(center_ap.y, map.center_y.c_str(), 10, MPFR_RNDN);
+            }
 
-            } else if (compute_mode == DOUBLE) {
-                zoom_on_center(mandelbrot.mandelbrot_rec_d, 1.f + zoom_factor);
+            // rows interleaved over the threads, neighbouring rows cost about the same
+            for (uint64_t row = row_begin + i; row < row_end; row += num_threads) {
+                double r = map.r_max * std::exp(-(double)row * map.log_step);
+                std::vector<Color>& samples = map.strip[row];
+
+                for (uint64_t column = 0; column < map.columns; ++column) {
+                    double angle = 2.0 * std::numbers::pi * column / map.columns;
+                    Vector2D offset = {r * std::cos(angle), r * std::sin(angle)};
+
+                    uint64_t n;
+                    double mag_squared;
+                    if (compute_mode == MPFR) {
+                        mpfr_add_d(point_ap.x, center_ap.x, offset.x, MPFR_RNDN);
+                        mpfr_add_d(point_ap.y, center_ap.y, offset.y, MPFR_RNDN);
+                        n = in_mandelbrot_set(point_ap, thread_mandelbrot_vectors[i], max_iter, mag_squared);
+                    } else {
+                        n = in_mandelbrot_set(Vector2D{map.center.x + offset.x, map.center.y + offset.y}, max_iter, mag_squared);
+                    }
+
+                    samples[column] = window.pixel_color(n > 0 ? smooth_iteration(n, mag_squared) : 0, max_iter);
+                }
             }
-            new_input = true;
-        }
+        });
+    }
 
-        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(GetMousePosition(), window.graph_rec)) {
-            Vector2 mouse_pos = GetMousePosition();
+    for (auto& t: render_workers) {
+        t.join();
+    }
+}
 
-            if (compute_mode == MPFR) {
-                mpfr_set_d(temp.x, mouse_pos.x, MPFR_RNDN);
-                mpfr_set_d(temp.y, mouse_pos.y, MPFR_RNDN);
-                RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
-                to_graph(temp, graph_rec_d, mandelbrot.mandelbrot_rec_mpfr);
-                center_on_point(temp, mandelbrot.mandelbrot_rec_mpfr);
+Color lerp_color(Color a, Color b, float t) {
+    return {(unsigned char)(a.r + (b.r - a.r) * t), (unsigned char)(a.g + (b.g - a.g) * t),
+            (unsigned char)(a.b + (b.b - a.b) * t), (unsigned char)(a.a + (b.a - a.a) * t)};
+}
 
-            } else if (compute_mode == DOUBLE) {
-                //print_vec(mouse_pos, "mouse_pos screen space");
-                to_graph(mouse_pos, window.graph_rec, mandelbrot.mandelbrot_rec_d);
-                //print_vec(mouse_pos, "mouse_pos graph space");
-                center_on_point({mouse_pos.x, mouse_pos.y}, mandelbrot.mandelbrot_rec_d);
-            }
+// bilinear lookup, wraps around in angle and clamps in radius
+Color sample_exp_map(const ExpMap& map, double row, double column) {
+    if (row < 0) row = 0;
+    if (row > map.rows - 1) row = map.rows - 1;
+
+    uint64_t row_0 = row;
+    uint64_t row_1 = row_0 + 1 < map.rows ? row_0 + 1 : row_0;
+    uint64_t column_0 = (uint64_t)column % map.columns;
+    uint64_t column_1 = (column_0 + 1) % map.columns;
+    float row_t = row - row_0;
+    float column_t = column - std::floor(column);
+
+    Color top = lerp_color(map.strip[row_0][column_0], map.strip[row_0][column_1], column_t);
+    Color bottom = lerp_color(map.strip[row_1][column_0], map.strip[row_1][column_1], column_t);
+    return lerp_color(top, bottom, row_t);
+}
 
-            new_input = true;
+// frame with pixel size unit, pixels are placed like in draw_mandelbrot_image
+void resample_exp_map(const ExpMap& map, Window& window, double unit) {
+    int width = window.graph_image.width;
+    int height = window.graph_image.height;
+    Color* pixels = (Color*)window.graph_image.data;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double dx = (x - width / 2.0) * unit;
+            double dy = -(y - height / 2.0) * unit;
+            double r = std::sqrt(dx * dx + dy * dy);
+            if (r <= 0) r = unit * 0.5;
+
+            double row = std::log(map.r_max / r) / map.log_step;
+            double angle = std::atan2(dy, dx);
+            if (angle < 0) angle += 2.0 * std::numbers::pi;
+            double column = angle / (2.0 * std::numbers::pi) * map.columns;
+
+            pixels[y * width + x] = sample_exp_map(map, row, column);
         }
+    }
+}
 
-        if (IsKeyPressed(KEY_M)) {
-            if (max_iter * 2 < max_iter) return;
-            max_iter *= 2;
-            window.fill_palette(max_iter);
-            new_input = true;
+// mean absolute channel difference of two images of the same size
+double image_difference(const Image& a, const Image& b) {
+    const Color* pa = (const Color*)a.data;
+    const Color* pb = (const Color*)b.data;
+    uint64_t count = (uint64_t)a.width * a.height;
+    double sum = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        sum += std::abs(pa[i].r - pb[i].r) + std::abs(pa[i].g - pb[i].g) + std::abs(pa[i].b - pb[i].b);
+    }
+    return sum / (count * 3.0);
+}
+
+int render_zoom_video(const HeadlessOptions& options, App& app) {
+    ExpMap map = init_exp_map(options);
+    Window& window = app.window;
+    int width = window.graph_image.width;
+    double half_diagonal = std::sqrt((double)width * width + (double)window.graph_image.height * window.graph_image.height) / 2.0;
+
+    std::println("zoom video: {} frames, exp map {}x{} samples", options.frames, map.columns, map.rows);
+
+    double strip_seconds = 0;
+    double resample_seconds = 0;
+    Image keyframe = ImageCopy(window.graph_image);
+
+    for (uint64_t frame = 0; frame < options.frames; ++frame) {
+        double zoom = std::pow(options.zoom, (double)frame / (options.frames - 1));
+        double unit = view_width / zoom / width;
+
+        // band of rows this frame touches, from the corners down to half a pixel
+        uint64_t row_first = std::max(0.0, std::floor(std::log(map.r_max / (unit * half_diagonal)) / map.log_step));
+        uint64_t row_last = std::min<double>(map.rows, std::ceil(std::log(map.r_max / (unit * 0.5)) / map.log_step) + 2);
+
+        if (row_last > map.rows_done) {
+            // render ahead so row batches stay large enough to keep every thread busy
+            uint64_t row_end = std::min<uint64_t>(map.rows, std::max<uint64_t>(row_last, map.rows_done + 64 * app.num_threads));
+            auto start = std::chrono::steady_clock::now();
+            render_exp_map_rows(map, window, app.compute_mode, app.max_iter, app.num_threads, map.rows_done, row_end);
+            strip_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            map.rows_done = row_end;
+        }
+        // the corner pixels' radius is rounded on its own and can land just below row_first, keep one row more
+        for (uint64_t row = 0; row + 1 < row_first; ++row) {
+            std::vector<Color>().swap(map.strip[row]);
         }
-        if (IsKeyPressed(KEY_L)) {
-            if (max_iter == 1) return;
 
-            max_iter /= 2;
-            if (max_iter < 1) max_iter = 1;
+        auto start = std::chrono::steady_clock::now();
+        resample_exp_map(map, window, unit);
+        resample_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-            if (!new_input) {
+        std::string path = std::format("{}_{:05}.png", options.out_path, frame);
+        if (!ExportImage(window.graph_image, path.c_str())) {
+            std::println(stderr, "could not write {}", path);
+            UnloadImage(keyframe);
+            return 1;
+        }
 
-                window.fill_palette(max_iter);
+        if (options.keyframe_interval > 0 && frame % options.keyframe_interval == 0) {
+            std::memcpy(keyframe.data, window.graph_image.data, (uint64_t)width * window.graph_image.height * sizeof(Color));
 
-            }
-            new_input = true;
+            set_view(app.mandelbrot, options.center_x, options.center_y, zoom, width, window.graph_image.height);
+            render_mandelbrot(window, app.mandelbrot, app.compute_mode, app.max_iter, app.num_threads);
+
+            std::string key_path = std::format("{}_key_{:05}.png", options.out_path, frame);
+            ExportImage(window.graph_image, key_path.c_str());
+            std::println("keyframe {}: zoom {:.3e}, mean channel difference {:.2f}", frame, zoom, image_difference(keyframe, window.graph_image));
         }
+    }
+    UnloadImage(keyframe);
 
-        if (show_info) {
-            float text_size = 20;
-            Vector2 mouse_pos = GetMousePosition();
+    uint64_t pixels = (uint64_t)width * window.graph_image.height;
+    double full_frames = (double)map.columns * map.rows / pixels;
+    std::println("exp map: {:.3f} s ({:.1f} full frames of samples), resampling: {:.3f} s",
+                 strip_seconds, full_frames, resample_seconds);
+    return 0;
+}
 
-            // PLEASE NO ENABLE - 8GB RAM in 1 SEK
+#ifndef _WIN32
 
-            //if (compute_mode == MPFR) {
-            //    mpfr_set_d(temp.x, mouse_pos.x, MPFR_RNDN);
-            //    mpfr_set_d(temp.y, mouse_pos.y, MPFR_RNDN);
-            //    //Vector2AP mouse_pos_mandelbrot = to_graph(mouse_pos_ap, window.graph_rec, mandelbrot.mandelbrot_rec);
-            //    RectangleD graph_rec_d = {window.graph_rec.x, window.graph_rec.y, window.graph_rec.width, window.graph_rec.height};
-            //    to_graph(temp, graph_rec_d, mandelbrot.mandelbrot_rec_mpfr);
+// Coordinator/worker rendering. Workers connect to the coordinator, the coordinator hands out
+// tiles and assembles the results as they come in. Messages are a header plus payload in native
+// byte order, so coordinator and workers have to run on the same architecture.
 
-            //    window.copy_img = ImageCopy(window.graph_image);
+enum MessageType : uint32_t {
+    MESSAGE_JOB = 1,
+    MESSAGE_RESULT = 2,
+    MESSAGE_QUIT = 3,
+};
 
-            //    ImageDrawText(&window.copy_img, TextFormat("%f, %f", mpfr_get_d(temp.x, MPFR_RNDN), mpfr_get_d(temp.y, MPFR_RNDN)), 0, 0, text_size, WHITE);
+struct MessageHeader {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size;
+};
 
-            //} else if (compute_mode == DOUBLE) {
-            //    to_graph(mouse_pos, window.graph_rec, mandelbrot.mandelbrot_rec_d);
-            //    window.copy_img = ImageCopy(window.graph_image);
-            //    ImageDrawText(&window.copy_img, TextFormat("%f, %f", mouse_pos.x, mouse_pos.y), 0, 0, text_size, WHITE);
-            //}
+// followed by the tile rectangle x, y, width, height as '\0' terminated decimal strings
+struct TileJob {
+    uint64_t tile_id;
+    int32_t width;
+    int32_t height;
+    uint64_t max_iter;
+    uint32_t compute_mode;
+    // the coordinator's window settings, ScalarType, OrbitKernel, RenderStrategy and InteriorMode
+    uint8_t scalar;
+    uint8_t kernel;
+    uint8_t strategy;
+    uint8_t interior;
+};
 
-            //UpdateTexture(window.copy_texture, window.copy_img.data);
-            //DrawTexture(window.copy_texture, 0, 0, WHITE);
-        }
+struct Tile {
+    int x;
+    int y;
+    int width;
+    int height;
+};
 
+constexpr uint64_t tiles_in_flight = 2;
+// once poll says a worker sent something the rest of the message has to follow within this
+constexpr int receive_timeout_seconds = 5;
+// TileJob plus four decimal strings of float_precision bits, with plenty of room
+constexpr uint64_t max_job_size = sizeof(TileJob) + 4 * 256;
+// a worker refuses larger tiles, 4096 x 4096
+constexpr uint64_t max_job_pixels = 1 << 24;
+
+bool send_all(int fd, const void* data, uint64_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= sent;
     }
+    return true;
+}
 
-    void new_frame() {
-        window.begin_frame();
+bool recv_all(int fd, void* data, uint64_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received <= 0) return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
 
-        // render new view to graph_image
+bool send_message(int fd, MessageType type, const void* payload, uint64_t size) {
+    MessageHeader header = {type, 0, size};
+    return send_all(fd, &header, sizeof(header)) && send_all(fd, payload, size);
+}
 
-        if (new_input) {
-            
-            cv.notify_one();
-            //render_to_img();
-            //if (compute_mode == MPFR) {
-            //    window.render_to_img(mandelbrot.mandelbrot_rec_mpfr, num_threads, max_iter);
+// false on a payload above max_size, the header is not to be trusted then
+bool recv_message(int fd, MessageHeader& header, std::vector<char>& payload, uint64_t max_size) {
+    if (!recv_all(fd, &header, sizeof(header))) return false;
+    if (header.size > max_size) return false;
+    payload.resize(header.size);
+    return recv_all(fd, payload.data(), header.size);
+}
 
-            //} else if (compute_mode == DOUBLE) {
-            //    window.render_to_img(mandelbrot.mandelbrot_rec_d, num_threads, max_iter);
-            //}
-            //new_input = false;
+// "unix:/path/to/socket" or "host:port"
+int open_socket(const std::string& address, bool listening) {
+    if (address.starts_with("unix:")) {
+        std::string path = address.substr(5);
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return -1;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) {
+            unlink(path.c_str());
+            if (bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(fd, max_threads) == 0) return fd;
+        } else {
+            if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) return fd;
         }
+        close(fd);
+        return -1;
+    }
 
-        controls();
-        // draw current view from graph_image on screen
-        Color tint = WHITE;
-        if (show_info) tint.a = 128;
-        window.draw_frame(tint);
+    uint64_t colon = address.rfind(':');
+    if (colon == std::string::npos) return -1;
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (listening) hints.ai_flags = AI_PASSIVE;
+    addrinfo* results;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* info = results; info; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, max_threads) == 0) break;
+        } else {
+            if (connect(fd, info->ai_addr, info->ai_addrlen) == 0) break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+    return fd;
+}
 
+// exact decimal string of an mpfr value, mpfr_set_str reads it back without loss
+std::string mpfr_to_string(const mpfr_t value) {
+    mpfr_exp_t exponent;
+    char* digits = mpfr_get_str(nullptr, &exponent, 10, 0, value, MPFR_RNDN);
+    std::string_view mantissa = digits;
+    std::string sign = "";
+    if (mantissa.starts_with('-')) {
+        sign = "-";
+        mantissa.remove_prefix(1);
     }
+    std::string result = std::format("{}0.{}e{}", sign, mantissa, (long)exponent);
+    mpfr_free_str(digits);
+    return result;
+}
 
-    void stop_threads() {
-        //threads_running = false;
-        //for (uint64_t& ready : window.threads_ready) {
-        //    ready = true;
-        //}
-        //cv.notify_all();
-        //for (std::thread& t : window.render_jobs) {
-        //    t.join();
-        //}
-        //
-        window.render_thread.request_stop();
-        new_input = true;
-        cv.notify_one();
+std::vector<char> make_tile_job(uint64_t tile_id, const Tile& tile, const App& app) {
+    const RectangleAP& view = app.mandelbrot.mandelbrot_rec_mpfr;
+    const Rectangle& graph_rec = app.window.graph_rec;
+
+    mpfr_t tile_x, tile_y, tile_width, tile_height;
+    mpfr_inits(tile_x, tile_y, tile_width, tile_height, (mpfr_ptr)nullptr);
+
+    // tile.x / graph width * view width + view x, y goes down like in to_graph
+    mpfr_mul_d(tile_x, view.width, tile.x / graph_rec.width, MPFR_RNDN);
+    mpfr_add(tile_x, tile_x, view.x, MPFR_RNDN);
+    mpfr_mul_d(tile_y, view.height, tile.y / graph_rec.height, MPFR_RNDN);
+    mpfr_sub(tile_y, view.y, tile_y, MPFR_RNDN);
+    mpfr_mul_d(tile_width, view.width, tile.width / graph_rec.width, MPFR_RNDN);
+    mpfr_mul_d(tile_height, view.height, tile.height / graph_rec.height, MPFR_RNDN);
+
+    const Window& window = app.window;
+    TileJob job = {tile_id, tile.width, tile.height, app.max_iter, (uint32_t)app.compute_mode,
+                   (uint8_t)window.scalar, (uint8_t)window.kernel, (uint8_t)window.strategy, (uint8_t)window.interior};
+    std::vector<char> payload((char*)&job, (char*)&job + sizeof(job));
+    for (mpfr_ptr value : {tile_x, tile_y, tile_width, tile_height}) {
+        std::string text = mpfr_to_string(value);
+        payload.insert(payload.end(), text.c_str(), text.c_str() + text.size() + 1);
     }
 
-    void init_mpfr_containers(uint64_t num_threads) {
-        mpfr_init(temp.x);
-        mpfr_init(temp.y);
+    mpfr_clears(tile_x, tile_y, tile_width, tile_height, (mpfr_ptr)nullptr);
+    return payload;
+}
 
-        mpfr_init(dif_halved);
-        mpfr_init(tmp);
+void assemble_tile(Window& window, const Tile& tile, const uint64_t* iterations, const float* smooth, uint64_t max_iter) {
+    int width = window.graph_image.width;
+    Color* pixels = (Color*)window.graph_image.data;
 
-        for(int i = 0; i < num_threads; ++i) {
-            thread_mandelbrot_vectors[i].init();
-            thread_draw_vectors[i].init();
+    for (int y = 0; y < tile.height; ++y) {
+        for (int x = 0; x < tile.width; ++x) {
+            uint64_t index = (uint64_t)(tile.y + y) * width + tile.x + x;
+            window.iterations[index] = iterations[y * tile.width + x];
+            window.smooth[index] = smooth[y * tile.width + x];
+            pixels[index] = window.pixel_color(window.smooth[index], max_iter);
         }
     }
+}
 
+struct TileInFlight {
+    uint64_t tile_id;
+    // dispatch, or the previous result of the same worker, which renders its tiles one after the other
+    std::chrono::steady_clock::time_point since;
 };
 
-void render_thread(std::stop_token st, App& app) {
-    std::unique_lock<std::mutex> lock(mtx);
+struct WorkerConnection {
+    int fd;
+    std::vector<TileInFlight> in_flight;
+};
 
+// this executable, for the local workers. Resolved at startup: argv[0] can be relative to the starting
+// directory or just a name that execvp looks up on the PATH
+std::string executable_path;
+
+void set_executable_path(const char* argv0) {
+#ifdef __linux__
+    const char* self = "/proc/self/exe";
+#else
+    const char* self = argv0;
+#endif
+    char* resolved = std::strchr(self, '/') ? realpath(self, nullptr) : nullptr;
+    executable_path = resolved ? resolved : argv0;
+    std::free(resolved);
+}
 
-    while (!st.stop_requested()) {
-        cv.wait(lock, [&app] {
-            return app.new_input;
-        });
-        if (st.stop_requested()) {
-            break;
+std::vector<pid_t> spawn_local_workers(const std::string& address, uint64_t count, uint64_t threads_per_worker) {
+    std::vector<pid_t> pids;
+    std::string threads = std::to_string(threads_per_worker);
+
+    for (uint64_t i = 0; i < count; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execlp(executable_path.c_str(), "plot", "--worker", "--connect", address.c_str(), "--threads", threads.c_str(), (char*)nullptr);
+            std::println(stderr, "could not start worker");
+            _exit(1);
         }
-        app.new_input = false;
+        if (pid > 0) pids.push_back(pid);
+    }
+    return pids;
+}
 
-        std::vector<std::jthread> render_workers;
+// renders app's view (set_view already called) on remote workers, assembles into app.window
+int render_distributed(const HeadlessOptions& options, App& app) {
+    int listen_fd = open_socket(options.listen_address, true);
+    if (listen_fd < 0) {
+        std::println(stderr, "could not listen on {}", options.listen_address);
+        return 1;
+    }
 
-        ImageDrawRectangleRec(&app.window.graph_image, app.window.graph_rec, app.window.bg_color);
+    std::vector<Tile> tiles;
+    for (int y = 0; y < options.height; y += options.tile_size) {
+        for (int x = 0; x < options.width; x += options.tile_size) {
+            tiles.push_back({x, y, std::min<int>(options.tile_size, options.width - x), std::min<int>(options.tile_size, options.height - y)});
+        }
+    }
+    std::deque<uint64_t> queue;
+    for (uint64_t i = 0; i < tiles.size(); ++i) queue.push_back(i);
+    std::vector<bool> tile_done(tiles.size(), false);
+    uint64_t tiles_done = 0;
+    uint64_t tiles_reissued = 0;
+
+    ImageDrawRectangleRec(&app.window.graph_image, app.window.graph_rec, app.window.bg_color);
+
+    std::vector<pid_t> local_workers;
+    if (options.spawn_workers > 0) {
+        uint64_t threads = options.num_threads_set ? options.num_threads : std::max<uint64_t>(1, default_num_threads() / options.spawn_workers);
+        local_workers = spawn_local_workers(options.listen_address, options.spawn_workers, threads);
+    }
 
-        for (int i = 0; i < app.num_threads; ++i) {
-            if (app.new_input) break;
-            render_workers.emplace_back(draw_mandelbrot_image, std::cref(app.mandelbrot.mandelbrot_rec_d), std::ref(app.window), app.max_iter, i);
+    std::vector<WorkerConnection> workers;
+    std::vector<char> payload;
+    // tile id, iterations and smooth of the largest tile
+    uint64_t max_result_size = sizeof(uint64_t) + (uint64_t)options.tile_size * options.tile_size * (sizeof(uint64_t) + sizeof(float));
+    // tiles of a dropped worker go back to the queue, the other workers get them after the poll round
+    bool reissue = false;
+
+    auto dispatch = [&](WorkerConnection& worker) {
+        while (worker.in_flight.size() < tiles_in_flight && !queue.empty()) {
+            uint64_t tile_id = queue.front();
+            std::vector<char> job = make_tile_job(tile_id, tiles[tile_id], app);
+            if (!send_message(worker.fd, MESSAGE_JOB, job.data(), job.size())) return false;
+            queue.pop_front();
+            worker.in_flight.push_back({tile_id, std::chrono::steady_clock::now()});
         }
+        return true;
+    };
+
+    auto drop_worker = [&](uint64_t i) {
+        for (const TileInFlight& tile : workers[i].in_flight) {
+            if (!tile_done[tile.tile_id]) {
+                queue.push_front(tile.tile_id);
+                ++tiles_reissued;
+            }
+        }
+        close(workers[i].fd);
+        workers.erase(workers.begin() + i);
+        reissue = true;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto idle_since = start;
+    int result = 0;
+
+    while (tiles_done < tiles.size()) {
+        std::vector<pollfd> fds = {{listen_fd, POLLIN, 0}};
+        for (WorkerConnection& worker : workers) fds.push_back({worker.fd, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) break;
+
+        // results first, the indices in fds shift once a worker is dropped
+        for (uint64_t i = workers.size(); i-- > 0;) {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            MessageHeader header;
+            if (!recv_message(workers[i].fd, header, payload, max_result_size) || header.type != MESSAGE_RESULT || payload.size() < sizeof(uint64_t)) {
+                std::println(stderr, "worker lost, reissuing {} tiles", workers[i].in_flight.size());
+                drop_worker(i);
+                continue;
+            }
 
-        if (app.new_input) {
-            for (auto& t: render_workers) { 
-                t.request_stop();
+            uint64_t tile_id;
+            std::memcpy(&tile_id, payload.data(), sizeof(tile_id));
+            std::erase_if(workers[i].in_flight, [&](const TileInFlight& tile) { return tile.tile_id == tile_id; });
+            if (!workers[i].in_flight.empty()) workers[i].in_flight.front().since = std::chrono::steady_clock::now();
+
+            uint64_t pixel_count = tile_id < tiles.size() ? (uint64_t)tiles[tile_id].width * tiles[tile_id].height : 0;
+            if (tile_id < tiles.size() && !tile_done[tile_id] &&
+                payload.size() == sizeof(uint64_t) * (1 + pixel_count) + sizeof(float) * pixel_count) {
+                const char* iterations = payload.data() + sizeof(uint64_t);
+                assemble_tile(app.window, tiles[tile_id], (const uint64_t*)iterations,
+                              (const float*)(iterations + sizeof(uint64_t) * pixel_count), app.max_iter);
+                tile_done[tile_id] = true;
+                ++tiles_done;
             }
+            if (!dispatch(workers[i])) drop_worker(i);
         }
 
-        for (auto& t: render_workers) { 
-            t.join();
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                // a worker that stalls mid message must not hang the whole render
+                timeval timeout = {receive_timeout_seconds, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                workers.push_back({fd, {}});
+                if (!dispatch(workers.back())) drop_worker(workers.size() - 1);
+            }
         }
 
-        //draw_axis(app.mandelbrot.mandelbrot_rec_d);
+        // a worker that hangs mid tile keeps its socket open, only the clock tells
+        auto now = std::chrono::steady_clock::now();
+        for (uint64_t i = workers.size(); i-- > 0;) {
+            if (workers[i].in_flight.empty()) continue;
+            if (std::chrono::duration<double>(now - workers[i].in_flight.front().since).count() > options.tile_timeout) {
+                std::println(stderr, "worker took over {} s for a tile, reissuing {} tiles (see --tile-timeout)",
+                             options.tile_timeout, workers[i].in_flight.size());
+                drop_worker(i);
+            }
+        }
 
-    } 
-}
+        if (reissue) {
+            reissue = false;
+            for (uint64_t i = workers.size(); i-- > 0;) {
+                if (!dispatch(workers[i])) drop_worker(i);
+            }
+        }
 
-Window init_window(int width, int height, const char* title, uint64_t max_iter, uint64_t num_threads, const RectangleD& mandelbrot_rec) {
-    Window window;
-    window.screen_size = {(float)width, (float)height};
-    window.graph_rec = {0, 0, (float)width, (float)height};
-    window.bg_color = BLACK;
-    window.fill_palette(max_iter_initial);
+        // idle workers do not count, only tiles someone is working on
+        for (const WorkerConnection& worker : workers) {
+            if (!worker.in_flight.empty()) idle_since = now;
+        }
+        if (std::chrono::duration<double>(now - idle_since).count() > worker_timeout_seconds) {
+            std::println(stderr, "no tiles in flight for {} s, giving up with {} of {} tiles done", worker_timeout_seconds, tiles_done, tiles.size());
+            result = 1;
+            break;
+        }
+    }
+    if (result == 0 && app.window.color_mapping == COLOR_HISTOGRAM) apply_histogram(app.window, app.max_iter, app.num_threads);
+    auto end = std::chrono::steady_clock::now();
 
-    InitWindow(window.screen_size.x, window.screen_size.y, title);
-    SetTraceLogLevel(LOG_WARNING);
-    SetTargetFPS(120);
+    for (WorkerConnection& worker : workers) {
+        send_message(worker.fd, MESSAGE_QUIT, nullptr, 0);
+        close(worker.fd);
+    }
+    close(listen_fd);
+    if (options.listen_address.starts_with("unix:")) unlink(options.listen_address.c_str() + 5);
+    for (pid_t pid : local_workers) waitpid(pid, nullptr, 0);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t pixels = (uint64_t)options.width * options.height;
+    std::println("{}x{} {} max_iter {} distributed, {} tiles ({} reissued): {:.3f} ms, {:.0f} pixels/s",
+                 options.width, options.height, options.compute_mode == MPFR ? "mpfr" : "double",
+                 options.max_iter, tiles.size(), tiles_reissued, seconds * 1000.0, pixels / seconds);
+    return result;
+}
 
-    window.graph_image = GenImageColor(window.graph_rec.width, window.graph_rec.height, window.bg_color);
-    window.graph_texture = LoadTextureFromImage(window.graph_image);
+int worker_main(int argc, char** argv) {
+    std::string address;
+    uint64_t num_threads = default_num_threads();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--worker") continue;
+        if (i + 1 >= argc) return 1;
+        std::string_view value = argv[++i];
+        if (arg == "--connect") address = value;
+        else if (arg == "--threads") num_threads = std::clamp<uint64_t>(std::strtoull(value.data(), nullptr, 10), 1, max_threads);
+    }
+    if (address.empty()) {
+        std::println(stderr, "usage: plot --worker --connect ADDRESS [--threads N]");
+        return 1;
+    }
 
-    window.copy_img = ImageCopy(window.graph_image);
-    window.copy_texture = LoadTextureFromImage(window.copy_img);
+    // the coordinator may still be starting up
+    int fd = -1;
+    for (int attempt = 0; attempt < 50 && fd < 0; ++attempt) {
+        fd = open_socket(address, false);
+        if (fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (fd < 0) {
+        std::println(stderr, "could not connect to {}", address);
+        return 1;
+    }
+
+    App app = init_headless_app(1, 1, max_iter_initial, num_threads);
+    std::vector<char> payload;
+    std::vector<char> result;
+
+    while (true) {
+        MessageHeader header;
+        if (!recv_message(fd, header, payload, max_job_size) || header.type != MESSAGE_JOB || payload.size() < sizeof(TileJob)) break;
+
+        TileJob job;
+        std::memcpy(&job, payload.data(), sizeof(job));
+        if (job.compute_mode > MPFR || job.scalar >= SCALAR_COUNT || job.kernel >= KERNEL_COUNT ||
+            job.strategy >= STRATEGY_COUNT || job.interior >= INTERIOR_COUNT) break;
+        if (job.width <= 0 || job.height <= 0 || (uint64_t)job.width * job.height > max_job_pixels) break;
+
+        // the four rectangle strings, each has to end inside the payload
+        const char* strings[4];
+        const char* text = payload.data() + sizeof(TileJob);
+        const char* payload_end = payload.data() + payload.size();
+        bool strings_ok = true;
+        for (const char*& string : strings) {
+            const char* end = text < payload_end ? (const char*)std::memchr(text, '\0', payload_end - text) : nullptr;
+            if (!end) {
+                strings_ok = false;
+                break;
+            }
+            string = text;
+            text = end + 1;
+        }
+        if (!strings_ok) break;
 
-    window.draw_recs.reserve(num_threads);
-    window.draw_recs.resize(num_threads);
+        Window& window = app.window;
+        if (window.graph_image.width != job.width || window.graph_image.height != job.height) {
+            UnloadImage(window.graph_image);
+            window = init_headless_window(job.width, job.height);
+        }
+        app.max_iter = job.max_iter;
+        app.compute_mode = (ComputeMode)job.compute_mode;
+        window.scalar = (ScalarType)job.scalar;
+        window.kernel = (OrbitKernel)job.kernel;
+        window.strategy = (RenderStrategy)job.strategy;
+        window.interior = (InteriorMode)job.interior;
+
+        RectangleAP& rec = app.mandelbrot.mandelbrot_rec_mpfr;
+        mpfr_ptr values[4] = {rec.x, rec.y, rec.width, rec.height};
+        for (int i = 0; i < 4; ++i) {
+            if (mpfr_set_str(values[i], strings[i], 10, MPFR_RNDN) != 0) strings_ok = false;
+        }
+        if (!strings_ok) break;
+        app.mandelbrot.mandelbrot_rec_d = {mpfr_get_d(rec.x, MPFR_RNDN), mpfr_get_d(rec.y, MPFR_RNDN),
+                                           mpfr_get_d(rec.width, MPFR_RNDN), mpfr_get_d(rec.height, MPFR_RNDN)};
+
+        render_mandelbrot(window, app.mandelbrot, app.compute_mode, app.max_iter, num_threads);
+
+        // tile id, iterations, smooth
+        result.resize(sizeof(uint64_t) * (1 + window.iterations.size()) + sizeof(float) * window.smooth.size());
+        char* out = result.data();
+        std::memcpy(out, &job.tile_id, sizeof(uint64_t));
+        out += sizeof(uint64_t);
+        std::memcpy(out, window.iterations.data(), sizeof(uint64_t) * window.iterations.size());
+        out += sizeof(uint64_t) * window.iterations.size();
+        std::memcpy(out, window.smooth.data(), sizeof(float) * window.smooth.size());
+        if (!send_message(fd, MESSAGE_RESULT, result.data(), result.size())) break;
+    }
 
-    return window;
+    close(fd);
+    return 0;
 }
 
+#endif
 
+int headless_main(int argc, char** argv) {
+    TRACE_THREAD_NAME("main");
+    HeadlessOptions options;
+    if (!parse_headless_args(argc, argv, options)) {
+        print_headless_usage();
+        return 1;
+    }
+    options.num_threads_set = options.num_threads > 0;
+    if (options.num_threads == 0) options.num_threads = default_num_threads();
+    if (options.num_threads > max_threads) options.num_threads = max_threads;
+
+    App app = init_headless_app(options.width, options.height, options.max_iter, options.num_threads);
+    app.compute_mode = options.compute_mode;
+    app.window.color_mapping = options.color_mapping;
+    app.window.aa_grid = options.aa_grid;
+    app.window.scalar = options.scalar;
+    app.window.kernel = options.kernel;
+    app.window.strategy = options.strategy;
+    app.window.interior = options.interior;
+    if (options.auto_max_iter) {
+        // zoom videos and distributed renders stay with the estimate for the final view
+        app.iteration_control = {true, options.max_iter_cap};
+        app.max_iter = app.iteration_control.limit(std::log2(view_width / options.zoom / options.width));
+        options.max_iter = app.max_iter;
+    }
+    if (options.frames > 1) {
+        return render_zoom_video(options, app);
+    }
 
-App init_app(int width, int height, const char* title, uint64_t num_threads) {
-    App app;
+    set_view(app.mandelbrot, options.center_x, options.center_y, options.zoom, options.width, options.height);
+
+    if (!options.listen_address.empty()) {
+#ifndef _WIN32
+        if (render_distributed(options, app) != 0) return 1;
+#else
+        std::println(stderr, "distributed rendering is not supported on windows");
+        return 1;
+#endif
+    } else {
+        RenderTimes times;
+        render_mandelbrot(app.window, app.mandelbrot, app.compute_mode, app.max_iter, app.num_threads, &times);
+        // auto: render again until the frame is happy with the limit, the time is the last render
+        while (options.auto_max_iter && app.iteration_control.update(app.window, app.max_iter)) {
+            app.max_iter = app.iteration_control.limit(view_log2_unit(app.window, app.mandelbrot, app.compute_mode));
+            render_mandelbrot(app.window, app.mandelbrot, app.compute_mode, app.max_iter, app.num_threads, &times);
+        }
+        options.max_iter = app.max_iter;
+
+        double seconds = std::chrono::duration<double>(times.done - times.start).count();
+        uint64_t pixels = (uint64_t)options.width * options.height;
+        std::println("{}x{} {} max_iter {} threads {}: {:.3f} ms, {:.0f} pixels/s",
+                     options.width, options.height, options.compute_mode == MPFR ? "mpfr" : "double",
+                     options.max_iter, options.num_threads, seconds * 1000.0, pixels / seconds);
+
+        if (!options.stats_path.empty()) {
+            FrameStats stats = collect_frame_stats(app.window, app.num_threads, app.max_iter, seconds);
+            stats.frame = 1;
+            if (!write_stats_json(stats, options.stats_path.c_str())) {
+                std::println(stderr, "could not write {}", options.stats_path);
+            }
+        }
+    }
 
-    app.compute_mode = DOUBLE;
-    app.num_threads = num_threads;
+    bool ok;
+    if (IsFileExtension(options.out_path.c_str(), ".raw")) {
+        ok = write_iterations(app.window, options.out_path.c_str());
+    } else if (distance_estimation && IsFileExtension(options.out_path.c_str(), ".dist")) {
+        ok = write_distance(app.window, options.out_path.c_str());
+    } else {
+        ok = ExportImage(app.window.graph_image, options.out_path.c_str());
+    }
+    if (!ok) {
+        std::println(stderr, "could not write {}", options.out_path);
+        return 1;
+    }
 
-    mpfr_set_default_prec(float_precision);
-    app.init_mpfr_containers(num_threads);
+#ifdef PLOT_TRACE
+    write_trace_json("plot_trace.json");
+#endif
+    return 0;
+}
 
-    app.mandelbrot.mandelbrot_rec_d = {-2.2f, 1.f, 3.2f, 2.f};
+#ifdef BENCH_PLOT
+
+// Fixed scenes for bench_plot. MPFR runs use a quarter of the width and height, the kernel is
+// about two orders of magnitude slower and the throughput numbers are per pixel anyway.
+struct BenchScene {
+    const char* name;
+    const char* center_x;
+    const char* center_y;
+    double zoom;
+    uint64_t max_iter;
+    int width;
+    int height;
+    bool double_ok;
+};
 
-    app.mandelbrot.mandelbrot_rec_mpfr.init();
-    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.x,      -2.2f, MPFR_RNDN);
-    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.y,       1.f,  MPFR_RNDN);
-    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.width,   3.2f, MPFR_RNDN);
-    mpfr_set_d(app.mandelbrot.mandelbrot_rec_mpfr.height,  2.f,  MPFR_RNDN);
+constexpr BenchScene bench_scenes[] = {
+    {"home", "-0.6", "0", 1.0, 256, 800, 600, true},
+    {"seahorse_valley", "-0.743643887037151", "0.131825904205330", 1000.0, 1000, 800, 600, true},
+    {"minibrot_interior", "-1.7548776662466927", "0", 80.0, 2000, 800, 600, true},
+    {"deep_mpfr", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 1e20, 2000, 400, 300, false},
+};
 
-    // MUSS LAST SEIN - > BRAUCHT DIE MANDELBROT DATEN
+struct BenchResult {
+    std::string scene;
+    ComputeMode compute_mode;
+    uint64_t num_threads;
+    int width;
+    int height;
+    uint64_t max_iter;
+    double seconds;
+    double first_tile_seconds;
+    uint64_t iterations;
+    double scaling_efficiency;
+    ScalarType scalar;
+};
+
+std::vector<uint64_t> parse_list(std::string_view text) {
+    std::vector<uint64_t> values;
+    while (!text.empty()) {
+        uint64_t comma = text.find(',');
+        std::string item(text.substr(0, comma));
+        values.push_back(std::strtoull(item.c_str(), nullptr, 10));
+        if (comma == std::string_view::npos) break;
+        text.remove_prefix(comma + 1);
+    }
+    return values;
+}
 
-    app.window = init_window(width, height, title, app.max_iter, app.num_threads, app.mandelbrot.mandelbrot_rec_d);
+void write_bench_json(FILE* file, const std::vector<BenchResult>& results, uint64_t repeat) {
+    std::println(file, "{{");
+    std::println(file, "  \"hardware_threads\": {},", std::thread::hardware_concurrency());
+    std::println(file, "  \"repeat\": {},", repeat);
+    std::println(file, "  \"results\": [");
+    for (uint64_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double pixels = (double)r.width * r.height;
+        std::println(file, "    {{\"scene\": \"{}\", \"mode\": \"{}\", \"threads\": {}, \"width\": {}, \"height\": {}, \"max_iter\": {}, "
+                           "\"seconds\": {:.6f}, \"first_tile_seconds\": {:.6f}, \"pixels_per_second\": {:.1f}, "
+                           "\"iterations_per_second\": {:.1f}, \"scaling_efficiency\": {:.4f}, \"scalar\": \"{}\"}}{}",
+                     r.scene, r.compute_mode == MPFR ? "mpfr" : "double", r.num_threads, r.width, r.height, r.max_iter,
+                     r.seconds, r.first_tile_seconds, pixels / r.seconds, r.iterations / r.seconds, r.scaling_efficiency,
+                     scalar_names[r.scalar],
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::println(file, "  ]");
+    std::println(file, "}}");
+}
+
+void print_bench_usage() {
+    std::println(stderr, "usage: bench_plot [--threads 1,2,4] [--modes double,mpfr] [--scalar T] [--kernel K] [--strategy S] [--interior I] [--scene NAME] [--repeat N] [--json FILE|-]");
+}
 
-    if (app.compute_mode == DOUBLE) {
-        app.init_render_threads(app.max_iter, num_threads, app.mandelbrot.mandelbrot_rec_d, app.window);
+int bench_main(int argc, char** argv) {
+    std::vector<uint64_t> thread_counts;
+    std::vector<ComputeMode> compute_modes = {DOUBLE, MPFR};
+    std::string scene_filter;
+    std::string json_path;
+    uint64_t repeat = 3;
+    ScalarType scalar = SCALAR_AUTO;
+    bool scalar_set = false;
+    OrbitKernel kernel = KERNEL_INTERLEAVED;
+    RenderStrategy strategy = STRATEGY_FULL;
+    InteriorMode interior = INTERIOR_OFF;
+
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            print_bench_usage();
+            return 1;
+        }
+        std::string_view arg = argv[i];
+        std::string_view value = argv[i + 1];
+        if (arg == "--threads") {
+            thread_counts = parse_list(value);
+        } else if (arg == "--modes") {
+            compute_modes.clear();
+            if (value.find("double") != std::string_view::npos) compute_modes.push_back(DOUBLE);
+            if (value.find("mpfr") != std::string_view::npos) compute_modes.push_back(MPFR);
+        } else if (arg == "--scene") {
+            scene_filter = value;
+        } else if (arg == "--json") {
+            json_path = value;
+        } else if (arg == "--repeat") {
+            repeat = std::max<uint64_t>(1, std::strtoull(value.data(), nullptr, 10));
+        } else if (arg == "--scalar" && std::find(std::begin(scalar_names), std::end(scalar_names), value) != std::end(scalar_names)) {
+            scalar = (ScalarType)(std::find(std::begin(scalar_names), std::end(scalar_names), value) - std::begin(scalar_names));
+            scalar_set = true;
+        } else if (arg == "--kernel" && std::find(std::begin(kernel_names), std::end(kernel_names), value) != std::end(kernel_names)) {
+            kernel = (OrbitKernel)(std::find(std::begin(kernel_names), std::end(kernel_names), value) - std::begin(kernel_names));
+        } else if (arg == "--strategy" && std::find(std::begin(strategy_names), std::end(strategy_names), value) != std::end(strategy_names)) {
+            strategy = (RenderStrategy)(std::find(std::begin(strategy_names), std::end(strategy_names), value) - std::begin(strategy_names));
+        } else if (arg == "--interior" && std::find(std::begin(interior_names), std::end(interior_names), value) != std::end(interior_names)) {
+            interior = (InteriorMode)(std::find(std::begin(interior_names), std::end(interior_names), value) - std::begin(interior_names));
+        } else {
+            print_bench_usage();
+            return 1;
+        }
+    }
+    if (thread_counts.empty()) {
+        for (uint64_t n = 1; n < default_num_threads(); n *= 2) thread_counts.push_back(n);
+        thread_counts.push_back(default_num_threads());
+    }
+    std::erase_if(thread_counts, [](uint64_t n) { return n == 0 || n > max_threads; });
+    if (thread_counts.empty()) return 1;
+    uint64_t most_threads = *std::max_element(thread_counts.begin(), thread_counts.end());
+
+    App app = init_headless_app(1, 1, max_iter_initial, most_threads);
+    std::vector<BenchResult> results;
+
+    // with the json on stdout the table goes to stderr, stdout stays valid json
+    FILE* table = json_path == "-" ? stderr : stdout;
+    std::println(table, "{:<18} {:<6} {:<13} {:>7} {:>10} {:>10} {:>14} {:>14} {:>8}",
+                 "scene", "mode", "scalar", "threads", "ms", "first tile", "pixels/s", "iterations/s", "scaling");
+
+    for (const BenchScene& scene : bench_scenes) {
+        if (!scene_filter.empty() && scene_filter != scene.name) continue;
+
+        for (ComputeMode compute_mode : compute_modes) {
+            if (compute_mode == DOUBLE && !scene.double_ok) continue;
+
+            int width = compute_mode == MPFR ? scene.width / 4 : scene.width;
+            int height = compute_mode == MPFR ? scene.height / 4 : scene.height;
+
+            UnloadImage(app.window.graph_image);
+            app.window = init_headless_window(width, height);
+            // mpfr rows time mpfr unless --scalar says otherwise, double rows let pick_scalar choose and
+            // the scalar column says what it took
+            app.window.scalar = scalar_set ? scalar : compute_mode == MPFR ? SCALAR_MPFR : SCALAR_AUTO;
+            app.window.kernel = kernel;
+            app.window.strategy = strategy;
+            app.window.interior = interior;
+            set_view(app.mandelbrot, scene.center_x, scene.center_y, scene.zoom, width, height);
+
+            double base_seconds = 0;
+            uint64_t base_threads = 0;
+
+            for (uint64_t num_threads : thread_counts) {
+
+                // best of repeat, the first run also warms up caches and the allocator
+                BenchResult result = {scene.name, compute_mode, num_threads, width, height, scene.max_iter, 0, 0, 0, 0};
+                for (uint64_t run = 0; run < repeat; ++run) {
+                    RenderTimes times;
+                    render_mandelbrot(app.window, app.mandelbrot, compute_mode, scene.max_iter, num_threads, &times);
+                    double seconds = std::chrono::duration<double>(times.done - times.start).count();
+                    if (run == 0 || seconds < result.seconds) {
+                        result.seconds = seconds;
+                        result.first_tile_seconds = std::chrono::duration<double>(times.first_tile - times.start).count();
+                    }
+                }
+                result.iterations = collect_frame_stats(app.window, num_threads, scene.max_iter, result.seconds).iterations;
+                result.scalar = app.window.scalar_used;
 
-    } else if (app.compute_mode == MPFR) {
-        app.init_render_threads(app.max_iter, num_threads, app.mandelbrot.mandelbrot_rec_mpfr, app.window);
+                if (base_threads == 0) {
+                    base_seconds = result.seconds;
+                    base_threads = num_threads;
+                }
+                result.scaling_efficiency = base_seconds * base_threads / (result.seconds * num_threads);
+
+                double pixels = (double)width * height;
+                std::println(table, "{:<18} {:<6} {:<13} {:>7} {:>10.2f} {:>10.2f} {:>14.0f} {:>14.0f} {:>8.3f}",
+                             result.scene, compute_mode == MPFR ? "mpfr" : "double", scalar_names[result.scalar], num_threads,
+                             result.seconds * 1000.0, result.first_tile_seconds * 1000.0,
+                             pixels / result.seconds, result.iterations / result.seconds, result.scaling_efficiency);
+                results.push_back(result);
+            }
+        }
     }
 
-    return app;
+    if (json_path == "-") {
+        write_bench_json(stdout, results, repeat);
+    } else if (!json_path.empty()) {
+        FILE* file = std::fopen(json_path.c_str(), "w");
+        if (!file) {
+            std::println(stderr, "could not write {}", json_path);
+            return 1;
+        }
+        write_bench_json(file, results, repeat);
+        std::fclose(file);
+    }
+    return 0;
 }
 
+#endif
 
+int main(int argc, char** argv) {
 
-int main() {
+#ifndef _WIN32
+    set_executable_path(argv[0]);
+#endif
 
+#ifdef BENCH_PLOT
+    return bench_main(argc, argv);
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--headless") return headless_main(argc, argv);
+        if (std::string_view(argv[i]) == "--worker") {
+#ifndef _WIN32
+            return worker_main(argc, argv);
+#else
+            std::println(stderr, "distributed rendering is not supported on windows");
+            return 1;
+#endif
+        }
+    }
 
     uint64_t num_threads = std::thread::hardware_concurrency() - 2;
     if (num_threads > max_threads) num_threads = max_threads;
     if (num_threads == 0) num_threads = 1;
 
+    TRACE_THREAD_NAME("main");
     App app = init_app(window_width, window_height, "Mandelbrot", num_threads);
 
     while(!WindowShouldClose()) {
@@ -830,6 +4770,11 @@ int main() {
     
     app.stop_threads();
 
+#ifdef PLOT_TRACE
+    app.window.render_thread.join();
+    write_trace_json("plot_trace.json");
+#endif
+
     CloseWindow();
     return 0;
 }